@@ -0,0 +1,127 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "../FastNN/FNN.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Runs the activation kernels of every instruction set this CPU supports against the scalar sigmoid, relu
+// and their derivatives from FNN.hpp. Odd lengths exercise the masked and scalar tails, the element after
+// the end has to stay untouched
+// sigmoid may be off by ULP_BOUND ulps. Below -708 (double) or -87 (float) the kernels clamp exp, so there the
+// output only has to be no bigger than where it saturates. relu and both derivatives have to match exactly,
+// and NaN has to come out of sigmoid as NaN
+
+// ================== Global Variables ==================
+
+#define ULP_BOUND 4
+
+// ================== Checks ==================
+
+const char* isa_names[] = {"scalar", "sse2", "avx2", "avx512"};
+int failures = 0;
+
+template<typename T> T exp_clamp();
+template<> double exp_clamp<double>(){ return 708; }
+template<> float exp_clamp<float>(){ return 87; }
+
+// Distance from ref in units of the last place of ref
+template<typename T>
+double ulps(T y, T ref){
+    if(isnan(ref) || isnan(y)) return isnan(ref) && isnan(y) ? 0 : numeric_limits<double>::infinity();
+    if(y == ref) return 0;
+    T a = fabs(ref);
+    T ulp = nextafter(a, numeric_limits<T>::infinity()) - a;
+    return fabs((double)y - ref) / ulp;
+}
+
+template<typename T>
+bool same(T a, T b){
+    return a == b || (isnan(a) && isnan(b));
+}
+
+// Random values over a wide range plus the edges of the exp clamp, infinities and NaN
+template<typename T>
+vector<T> inputs(int n){
+    T hi = exp_clamp<T>();
+    T special[] = {0, -0.0, 1e-30, -1e-30, 1, -1, 20, -20, 36, -36, hi, -hi, hi + 1, -hi - 1, hi + 0.5f, -hi - 0.5f,
+                   10 * hi, -10 * hi, numeric_limits<T>::infinity(), -numeric_limits<T>::infinity(), numeric_limits<T>::quiet_NaN()};
+    int specials = sizeof(special) / sizeof(special[0]);
+    vector<T> x(n);
+    for(int i = 0; i < n; i++){
+        // Every special value lands both in the vector body and in the tail of some length
+        x[i] = i % 3 == 0 ? special[(i / 3) % specials] : (rand() % 200000 - 100000) / (T)100000 * (i % 2 ? 50 : 1000);
+    }
+    return x;
+}
+
+template<typename T>
+void check(const char* type, int isa){
+    ActKernels<T> k = act_kernels<T>(isa);
+    if(k.isa != isa) return; // not supported here
+    T hi = exp_clamp<T>();
+    T saturated = 1 / (1 + exp(hi));
+    const T guard = -12345;
+    double worst = 0;
+    long long checked = 0;
+
+    for(int n : {1, 3, 5, 7, 9, 15, 17, 31, 33, 63, 1001, 4097}){
+        vector<T> x = inputs<T>(n);
+        vector<T> y(n + 1, guard), r(n + 1, guard), g(n + 1, guard);
+        for(int i = 0; i < n; i++) g[i] = (rand() % 2000 - 1000) / (T)1000;
+        vector<T> gr = g, gs = g; // gs keeps the gradient from before the kernels
+
+        k.sigmoid(x.data(), y.data(), n);
+        k.relu(x.data(), r.data(), n);
+        // The derivatives run on the outputs the kernels produced, so they are compared on the same y
+        k.sigmoid_d(x.data(), y.data(), g.data(), n);
+        k.relu_d(x.data(), r.data(), gr.data(), n);
+
+        for(int i = 0; i < n; i++){
+            T ref = sigmoid<T>(x[i]);
+            double u = ulps(y[i], ref);
+            bool ok = u <= ULP_BOUND || (x[i] <= -hi && y[i] >= 0 && y[i] <= saturated * (1 + 4 * numeric_limits<T>::epsilon()));
+            if(!(x[i] <= -hi)) worst = max(worst, u);
+            bool exact = same(relu<T>(x[i]), r[i]) && same(gs[i] * sigmoid_d<T>(x[i], y[i]), g[i])
+                      && same(relu_d<T>(x[i], r[i]) ? gs[i] : 0, gr[i]);
+            if(!ok || !exact){
+                if(failures < 10){
+                    cout << "  mismatch " << type << " " << k.name << " n " << n << " x " << x[i] << ": sigmoid " << y[i] << " vs " << ref
+                         << ", relu " << r[i] << ", derivatives " << g[i] << " " << gr[i] << endl;
+                }
+                failures++;
+            }
+            checked++;
+        }
+        if(y[n] != guard || r[n] != guard || g[n] != guard || gr[n] != guard){
+            if(failures < 10) cout << "  " << type << " " << k.name << " wrote past n " << n << endl;
+            failures++;
+        }
+    }
+    cout << setw(8) << type << setw(8) << k.name << setw(10) << checked
+         << setw(16) << fixed << setprecision(2) << worst << endl;
+    cout.unsetf(ios::fixed);
+}
+
+int main(){
+    srand(SEED);
+    cout << "Activation kernels against the scalar functions, sigmoid error in ulps (bound " << ULP_BOUND << ")" << endl;
+    cout << "best supported: " << isa_names[cpu_isa()] << endl;
+    cout << setw(8) << "type" << setw(8) << "isa" << setw(10) << "values" << setw(16) << "worst sigmoid" << endl;
+    for(int isa = ISA_SCALAR; isa <= cpu_isa(); isa++){
+        check<double>("double", isa);
+        check<float>("float", isa);
+    }
+
+    if(failures > 0){
+        cout << failures << " mismatches" << endl;
+        return 1;
+    }
+    cout << "all match" << endl;
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <iostream>
+#include <cmath>
+
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/QFNN.hpp"
+#include "../FastNN/dataset.hpp"
+#include "../FastNN/alloc_hook.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Counts heap allocations on the training and inference hot paths
+// Everything after setup must stay at zero, the exit code is 1 otherwise
+
+// ================== Global Variables ==================
+
+#define EPOCHS 100
+#define BATCH_SIZE 32
+
+// ================== Check ==================
+
+int failed = 0;
+
+void report(const char* name, size_t before){
+    size_t n = alloc_count() - before;
+    cout << name << ": " << n << " allocations" << endl;
+    if(n != 0) failed = 1;
+}
+
+int main(){
+    srand(SEED);
+    int training_n = 1000;
+    Data_Entry<double>* training_data = getCircleData<double>(training_n, 10, 10, 3, 4, 2);
+
+    // Setup, allowed to allocate
+    int layer_sz[] = {2, 64, 64, 2};
+    double lr = 1;
+    FNN<double> nn(3, layer_sz, _sigmoid, lr);
+    nn.reserve_batch(BATCH_SIZE);
+    nn.train_batch(training_data, BATCH_SIZE, BATCH_SIZE, 1, lr); // first use of the gemm packing buffers
+    QuantizedFNN<double> qnn(nn, training_data, 100);
+
+    size_t before = alloc_count();
+    nn.train(training_data, training_n, EPOCHS, lr);
+    report("train", before);
+
+    before = alloc_count();
+    nn.train_batch(training_data, training_n, BATCH_SIZE, EPOCHS, lr);
+    report("train_batch", before);
+
+    Dataset<double> data(training_data, training_n, 2, 2, SEED);
+    before = alloc_count();
+    nn.train(data, EPOCHS, lr, true);
+    nn.train_batch(data, BATCH_SIZE, EPOCHS, lr, true);
+    report("train on a shuffled Dataset", before);
+
+    before = alloc_count();
+    for(int i = 0; i < training_n; i++) nn.forward(training_data[i].first);
+    report("forward", before);
+
+    double* inputs = new double[training_n * 2];
+    double* outputs = new double[training_n * 2];
+    for(int i = 0; i < training_n; i++){
+        inputs[i*2] = training_data[i].first[0];
+        inputs[i*2+1] = training_data[i].first[1];
+    }
+    before = alloc_count();
+    nn.forward_batch(inputs, training_n, outputs);
+    report("forward_batch", before);
+
+    before = alloc_count();
+    for(int i = 0; i < training_n; i++) qnn.forward(training_data[i].first);
+    report("quantized forward", before);
+
+    return failed;
+}
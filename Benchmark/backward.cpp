@@ -0,0 +1,133 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/dataset.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// One training step per sample three ways:
+// two sweeps  - forward, every delta, then every weight update, the weights are read twice (how backward used to work)
+// fused       - backward, forward then one sweep that propagates the delta and updates each row together
+// cached      - the caller already ran forward to read the output, backward_cached skips running it again
+// All three have to end with bit-identical weights
+
+// ================== Global Variables ==================
+
+#define SAMPLES 2000
+#define EPOCHS 3
+#define LR 0.1
+
+// ================== Benchmark ==================
+
+// The old backward, every delta down the columns of the weights and then a separate update pass
+void two_sweeps(FNN<double>& nn, Vec<double> input, Vec<double> result, double lr, Scratch<double>& s){
+    int layer_n = nn.layer_n;
+    int* layer_sz = nn.layer_sz;
+    Vec<double> output = nn.forward(input, s);
+    for(int i = 0; i < layer_sz[layer_n]; i++){
+        s.delta[layer_n-1][i] = result[i] - output[i];
+    }
+    nn.act_d_layer(s.before[layer_n-1], s.after[layer_n-1], s.delta[layer_n-1], layer_sz[layer_n]);
+    for(int i = layer_n-2; i >= 0; i--){
+        for(int j = 0; j < layer_sz[i+1]; j++){
+            double sum = 0;
+            for(int k = 0; k < layer_sz[i+2]; k++){
+                sum += s.delta[i+1][k] * nn.weights[i+1][k][j];
+            }
+            s.delta[i][j] = sum;
+        }
+        nn.act_d_layer(s.before[i], s.after[i], s.delta[i], layer_sz[i+1]);
+    }
+    for(int i = 0; i < nn.layer_n; i++){
+        int in = nn.layer_sz[i], out = nn.layer_sz[i+1];
+        Vec<double> prev = i == 0 ? s.input : s.after[i-1];
+        for(int j = 0; j < out; j++){
+            Vec<double> w = nn.weights_flat[i] + (size_t)j * in;
+            double d = lr * s.delta[i][j];
+            for(int k = 0; k < in; k++){
+                w[k] += d * prev[k];
+            }
+        }
+    }
+}
+
+// ns per sample of EPOCHS epochs, the weights it ended with go to weights
+template<typename F>
+double run(int layer_n, int* layer_sz, Dataset<double>& data, F step, vector<double>& weights){
+    srand(SEED);
+    vector<int> sizes(layer_sz, layer_sz + layer_n + 1); // the constructor adds the bias to the copy
+    FNN<double> nn(layer_n, sizes.data(), _sigmoid, LR);
+    Scratch<double> s = nn.own_scratch();
+    auto startTime = chrono::high_resolution_clock::now();
+    for(int e = 0; e < EPOCHS; e++){
+        for(int i = 0; i < data.n; i++){
+            step(nn, data.input(i), data.target(i), s);
+        }
+    }
+    auto endTime = chrono::high_resolution_clock::now();
+    weights.resize(nn.model_size() / sizeof(double));
+    nn.snapshot(weights.data());
+    return chrono::duration<double, nano>(endTime - startTime).count() / ((double)EPOCHS * data.n);
+}
+
+void compare(int layer_n, int* layer_sz){
+    srand(SEED);
+    int in = layer_sz[0], out = layer_sz[layer_n];
+    Dataset<double> data(SAMPLES, in, out, SEED);
+    for(int i = 0; i < SAMPLES; i++){
+        for(int k = 0; k < in; k++) data.input(i)[k] = (rand() % 1000) / 100.0;
+        for(int k = 0; k < out; k++) data.target(i)[k] = rand() % 2;
+    }
+
+    // Weights once per sample for the update and once for the deltas of every layer but the first
+    size_t bytes = 0;
+    for(int i = 0; i < layer_n; i++) bytes += (size_t)layer_sz[i+1] * (layer_sz[i] + (i == 0)) * sizeof(double);
+
+    vector<double> ref, fused, cached;
+    volatile double sink = 0;
+    double two = run(layer_n, layer_sz, data, [&](FNN<double>& nn, Vec<double> x, Vec<double> y, Scratch<double>& s){
+        sink = sink + nn.forward(x, s)[0];
+        two_sweeps(nn, x, y, LR, s);
+    }, ref);
+    double one = run(layer_n, layer_sz, data, [&](FNN<double>& nn, Vec<double> x, Vec<double> y, Scratch<double>& s){
+        sink = sink + nn.forward(x, s)[0];
+        nn.backward(x, y, LR, s);
+    }, fused);
+    double reuse = run(layer_n, layer_sz, data, [&](FNN<double>& nn, Vec<double> x, Vec<double> y, Scratch<double>& s){
+        sink = sink + nn.forward(x, s)[0];
+        nn.backward_cached(y, LR, s);
+    }, cached);
+
+    bool same = ref.size() == fused.size() && memcmp(ref.data(), fused.data(), ref.size() * sizeof(double)) == 0
+             && memcmp(ref.data(), cached.data(), ref.size() * sizeof(double)) == 0;
+
+    string topology;
+    for(int i = 0; i <= layer_n; i++) topology += (i ? "-" : "") + to_string(layer_sz[i]);
+    cout << setw(22) << topology << fixed << setprecision(0)
+         << setw(12) << bytes / 1024
+         << setw(14) << two << setw(14) << one << setw(14) << reuse
+         << setw(10) << setprecision(2) << two / reuse
+         << setw(11) << (same ? "yes" : "NO") << endl;
+    if(!same) exit(1);
+}
+
+int main(){
+    cout << "ns per sample of reading the output and training on it" << endl;
+    cout << setw(22) << "topology" << setw(12) << "weight KB" << setw(14) << "two sweeps" << setw(14) << "fused"
+         << setw(14) << "cached" << setw(10) << "speedup" << setw(11) << "identical" << endl;
+
+    int small[] = {2, 20, 20, 2};
+    compare(3, small);
+    int medium[] = {2, 128, 128, 2};
+    compare(3, medium);
+    int wide[] = {32, 512, 512, 512, 10};
+    compare(4, wide);
+
+    return 0;
+}
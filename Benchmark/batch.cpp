@@ -0,0 +1,82 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono>
+
+#include "../FastNN/FNN.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Inference throughput of forward one sample at a time against forward_batch
+
+// ================== Global Variables ==================
+
+#define SAMPLES 20000
+#define REPEATS 5
+
+// ================== Benchmark ==================
+
+void run(int layer_n, int* layer_sz){
+    srand(SEED);
+    int in = layer_sz[0], out = layer_sz[layer_n];
+    FNN<double> nn(layer_n, layer_sz, _sigmoid, 1);
+
+    double* inputs = new double[(size_t)SAMPLES * in];
+    double* outputs = new double[(size_t)SAMPLES * out];
+    for(size_t i = 0; i < (size_t)SAMPLES * in; i++){
+        inputs[i] = (rand() % 1000) / 100.0;
+    }
+
+    // One sample at a time
+    double maxDiff = 0;
+    auto startTime = chrono::high_resolution_clock::now();
+    for(int r = 0; r < REPEATS; r++){
+        for(int i = 0; i < SAMPLES; i++){
+            Vec<double> res = nn.forward(inputs + (size_t)i * in);
+            if(r == 0) for(int j = 0; j < out; j++) outputs[(size_t)i * out + j] = res[j];
+        }
+    }
+    auto endTime = chrono::high_resolution_clock::now();
+    double single = (double)SAMPLES * REPEATS / chrono::duration<double>(endTime - startTime).count();
+
+    // Batched
+    double* batched = new double[(size_t)SAMPLES * out];
+    startTime = chrono::high_resolution_clock::now();
+    for(int r = 0; r < REPEATS; r++){
+        nn.forward_batch(inputs, SAMPLES, batched);
+    }
+    endTime = chrono::high_resolution_clock::now();
+    double batch = (double)SAMPLES * REPEATS / chrono::duration<double>(endTime - startTime).count();
+
+    for(size_t i = 0; i < (size_t)SAMPLES * out; i++){
+        maxDiff = max(maxDiff, fabs(outputs[i] - batched[i]));
+    }
+
+    string topology;
+    for(int i = 0; i <= layer_n; i++){
+        topology += (i ? "-" : "") + to_string(i == 0 ? in : layer_sz[i]);
+    }
+    cout << setw(20) << topology << fixed
+         << setw(14) << setprecision(0) << single
+         << setw(14) << setprecision(0) << batch
+         << setw(10) << setprecision(2) << batch / single
+         << setw(12) << scientific << setprecision(1) << maxDiff << endl;
+
+    delete[] inputs;
+    delete[] outputs;
+    delete[] batched;
+}
+
+int main(){
+    cout << setw(20) << "topology" << setw(14) << "forward/s" << setw(14) << "batch/s" << setw(10) << "speedup" << setw(12) << "max diff" << endl;
+
+    int small[] = {2, 20, 20, 2};
+    run(3, small);
+    int medium[] = {2, 128, 128, 2};
+    run(3, medium);
+    int wide[] = {32, 512, 512, 512, 10};
+    run(4, wide);
+
+    return 0;
+}
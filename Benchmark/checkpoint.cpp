@@ -0,0 +1,118 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <cstdio>
+
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/checkpoint.hpp"
+#include "../FastNN/memory.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Background checkpoints: how long the training thread stalls per checkpoint against a plain memcpy
+// and a synchronous save, and whether resuming from a checkpoint gives the same model as never stopping
+
+// ================== Global Variables ==================
+
+#define PATH "checkpoint.fnn"
+
+// ================== Data ==================
+
+bool same_weights(FNN<double>& a, FNN<double>& b){
+    for(int i = 0; i < a.layer_n; i++){
+        size_t sz = (size_t)a.layer_sz[i+1] * a.layer_sz[i] * sizeof(double);
+        if(memcmp(a.weights_flat[i], b.weights_flat[i], sz) != 0) return false;
+    }
+    return true;
+}
+
+// ================== Benchmark ==================
+
+int main(){
+    int failed = 0;
+    srand(SEED);
+    int training_n = 1000;
+    Data_Entry<double>* training_data = getCircleData<double>(training_n, 10, 10, 3, 4, 2);
+
+    // Resume, 60 epochs in one go against 30, checkpoint, load, 30 more
+    // The model is moved halfway through the first 30, the checkpointer has to follow it
+    int epochs = 30;
+    int sz_a[] = {2, 20, 20, 2};
+    int sz_b[] = {2, 20, 20, 2};
+    srand(SEED);
+    double lr_a = 1;
+    FNN<double> a(3, sz_a, _sigmoid, lr_a);
+    a.train(training_data, training_n, 2 * epochs, lr_a);
+
+    srand(SEED);
+    double lr_b = 1;
+    FNN<double> b(3, sz_b, _sigmoid, lr_b);
+    {
+        Checkpointer<double> ckpt(b, PATH, epochs, 0);
+        b.train(training_data, training_n, epochs / 2, lr_b);
+        FNN<double> moved(std::move(b));
+        moved.train(training_data, training_n, epochs - epochs / 2, lr_b);
+        ckpt.flush();
+        if(ckpt.written != 1) failed = 1;
+    }
+    FNN<double> c = FNN<double>::load_mmap(PATH);
+    double lr_c = c.lr;
+    cout << "resumed at epoch " << c.epoch << ", lr " << lr_c << endl;
+    c.train(training_data, training_n, epochs, lr_c);
+    bool same = same_weights(a, c) && lr_a == lr_c && a.epoch == c.epoch;
+    cout << "resumed model matches uninterrupted run: " << (same ? "yes" : "NO") << endl;
+    if(!same) failed = 1;
+
+    // train_parallel meets at every epoch boundary, so a checkpoint every 2 epochs out of 5 holds epoch 4's weights
+    {
+        srand(SEED);
+        double lr_p = 1;
+        FNN<double> p(3, sz_a, _sigmoid, lr_p);
+        Checkpointer<double> ckpt(p, PATH, 2, 0);
+        p.train_parallel(training_data, training_n, 5, lr_p, 2);
+        ckpt.flush();
+        FNN<double> q = FNN<double>::load_mmap(PATH);
+        bool ok = ckpt.requested == 2 && q.epoch == 4 && !same_weights(p, q);
+        cout << "train_parallel checkpoints " << ckpt.requested << ", last at epoch " << q.epoch << " before the end: " << (ok ? "yes" : "NO") << endl;
+        if(!ok) failed = 1;
+    }
+
+    // Stall, a wide net checkpointed after every epoch
+    int sz_w[] = {2, 512, 512, 512, 2};
+    srand(SEED);
+    double lr_w = 0.01;
+    FNN<double> w(4, sz_w, _sigmoid, lr_w);
+    size_t bytes = w.model_size();
+
+    double* copy = aligned_new<double>(bytes / sizeof(double));
+    auto startTime = chrono::high_resolution_clock::now();
+    w.snapshot(copy);
+    auto endTime = chrono::high_resolution_clock::now();
+    double memcpy_us = chrono::duration<double, micro>(endTime - startTime).count();
+    aligned_delete(copy);
+
+    startTime = chrono::high_resolution_clock::now();
+    w.save(PATH);
+    endTime = chrono::high_resolution_clock::now();
+    double save_us = chrono::duration<double, micro>(endTime - startTime).count();
+
+    Checkpointer<double> ckpt(w, PATH, 1, 0);
+    startTime = chrono::high_resolution_clock::now();
+    w.train(training_data, 100, 20, lr_w);
+    endTime = chrono::high_resolution_clock::now();
+    double train_ms = chrono::duration<double, milli>(endTime - startTime).count();
+    ckpt.flush();
+
+    cout << fixed << setprecision(1);
+    cout << "model " << bytes / 1024.0 << " KiB, 20 epochs in " << train_ms << " ms" << endl;
+    cout << "snapshot copy " << memcpy_us << " us, synchronous save " << save_us << " us" << endl;
+    cout << "checkpoints " << ckpt.requested << " taken, " << ckpt.written << " written, " << ckpt.failed << " failed" << endl;
+    cout << "stall per checkpoint " << ckpt.stall_ns / ckpt.requested / 1000 << " us avg, " << ckpt.max_stall_ns / 1000 << " us max" << endl;
+    if(ckpt.failed) failed = 1;
+
+    remove(PATH);
+    return failed;
+}
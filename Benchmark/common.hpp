@@ -0,0 +1,55 @@
+#ifndef BENCHMARK_COMMON_HPP
+#define BENCHMARK_COMMON_HPP
+
+#include <cmath>
+#include <cstdlib>
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/dataset.hpp"
+
+// Shared by the benchmarks, the seed every run starts from and the circle data Visual trains on
+
+// ================== Global Variables ==================
+
+#define SEED 42
+
+// ================== Data ==================
+
+// A point in the w x h box, target {1, 0} when it is within r of (x, y) and {0, 1} otherwise
+// The points come from rand(), call srand(SEED) first to get the same ones on every run
+template<typename T>
+void circlePoint(int w, int h, double x, double y, double r, T* input, T* output){
+    double cx = (rand() % 1000) * (double)w / 1000;
+    double cy = (rand() % 1000) * (double)h / 1000;
+
+    double dist = sqrt((cx-x)*(cx-x) + (cy-y)*(cy-y));
+
+    input[0] = cx;
+    input[1] = cy;
+    output[0] = dist <= r ? 1.0 : 0.0;
+    output[1] = dist > r ? 1.0 : 0.0;
+}
+
+// A pair of heap arrays per sample, the layout the Data_Entry training functions take
+template<typename T>
+Data_Entry<T>* getCircleData(int n, int w, int h, double x, double y, double r){
+    Data_Entry<T>* res = new Data_Entry<T>[n];
+    for(int i = 0; i < n; i++){
+        Vec<T> input = new T[2];
+        Vec<T> output = new T[2];
+        circlePoint(w, h, x, y, r, input, output);
+        res[i] = {input, output};
+    }
+    return res;
+}
+
+// The same points as getCircleData from the same rand() state, in one Dataset
+template<typename T>
+Dataset<T> getCircleDataset(int n, int w, int h, double x, double y, double r){
+    Dataset<T> res(n, 2, 2, SEED);
+    for(int i = 0; i < n; i++){
+        circlePoint(w, h, x, y, r, res.input(i), res.target(i));
+    }
+    return res;
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <stdexcept>
+
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/dataset.hpp"
+#include "../FastNN/alloc_hook.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// A pair of heap arrays per sample against one Dataset with two contiguous blocks:
+// allocations and time to build, time per epoch, and whether both train to the same weights
+
+// ================== Global Variables ==================
+
+#define SAMPLES 200000
+#define EPOCHS 3
+#define BATCH_SIZE 64
+
+// ================== Data ==================
+
+bool same_weights(FNN<double>& a, FNN<double>& b){
+    for(int i = 0; i < a.layer_n; i++){
+        size_t sz = (size_t)a.layer_sz[i+1] * a.layer_sz[i] * sizeof(double);
+        if(memcmp(a.weights_flat[i], b.weights_flat[i], sz) != 0) return false;
+    }
+    return true;
+}
+
+double ms_since(chrono::high_resolution_clock::time_point start){
+    return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// ================== Benchmark ==================
+
+int main(){
+    int failed = 0;
+    int n = SAMPLES;
+    int layer_sz_a[] = {2, 20, 20, 2};
+    int layer_sz_b[] = {2, 20, 20, 2};
+    cout << fixed << setprecision(1);
+
+    // Build
+    srand(SEED);
+    size_t before = alloc_count();
+    auto start = chrono::high_resolution_clock::now();
+    Data_Entry<double>* pairs = getCircleData<double>(n, 10, 10, 3, 4, 2);
+    double pairs_ms = ms_since(start);
+    size_t pairs_allocs = alloc_count() - before;
+
+    srand(SEED);
+    before = alloc_count();
+    start = chrono::high_resolution_clock::now();
+    Dataset<double> data = getCircleDataset<double>(n, 10, 10, 3, 4, 2);
+    double data_ms = ms_since(start);
+    size_t data_allocs = alloc_count() - before;
+
+    cout << n << " samples" << endl;
+    cout << setw(12) << "" << setw(12) << "allocs" << setw(12) << "build ms" << setw(12) << "train ms" << setw(12) << "batch ms" << endl;
+
+    // Same seed and order, so both layouts have to end with the same weights
+    srand(SEED);
+    double lr_a = 1;
+    FNN<double> a(3, layer_sz_a, _sigmoid, lr_a);
+    start = chrono::high_resolution_clock::now();
+    a.train(pairs, n, EPOCHS, lr_a);
+    double pairs_train = ms_since(start);
+    start = chrono::high_resolution_clock::now();
+    a.train_batch(pairs, n, BATCH_SIZE, EPOCHS, lr_a);
+    double pairs_batch = ms_since(start);
+
+    srand(SEED);
+    double lr_b = 1;
+    FNN<double> b(3, layer_sz_b, _sigmoid, lr_b);
+    start = chrono::high_resolution_clock::now();
+    b.train(data, EPOCHS, lr_b);
+    double data_train = ms_since(start);
+    start = chrono::high_resolution_clock::now();
+    b.train_batch(data, BATCH_SIZE, EPOCHS, lr_b);
+    double data_batch = ms_since(start);
+
+    cout << setw(12) << "pairs" << setw(12) << pairs_allocs << setw(12) << pairs_ms << setw(12) << pairs_train / EPOCHS << setw(12) << pairs_batch / EPOCHS << endl;
+    cout << setw(12) << "Dataset" << setw(12) << data_allocs << setw(12) << data_ms << setw(12) << data_train / EPOCHS << setw(12) << data_batch / EPOCHS << endl;
+    bool same = same_weights(a, b);
+
+    // Shuffled every epoch, only the order moves
+    start = chrono::high_resolution_clock::now();
+    b.train(data, EPOCHS, lr_b, true);
+    double shuffled_train = ms_since(start);
+    start = chrono::high_resolution_clock::now();
+    b.train_batch(data, BATCH_SIZE, EPOCHS, lr_b, true);
+    double shuffled_batch = ms_since(start);
+    cout << setw(12) << "shuffled" << setw(12) << "" << setw(12) << "" << setw(12) << shuffled_train / EPOCHS << setw(12) << shuffled_batch / EPOCHS << endl;
+
+    cout << "same weights without shuffling: " << (same ? "yes" : "NO") << endl;
+    if(!same) failed = 1;
+
+    // A network with one more input than the data has is refused before a row is read
+    int layer_sz_c[] = {3, 20, 20, 2};
+    double lr_c = 1;
+    FNN<double> c(3, layer_sz_c, _sigmoid, lr_c);
+    try{
+        c.train(data, 1, lr_c);
+        cout << "wrong width accepted" << endl;
+        failed = 1;
+    }catch(const invalid_argument& e){
+        cout << "wrong width refused: " << e.what() << endl;
+    }
+
+    // A batch size of 0 would step through the data forever
+    try{
+        b.train_batch(data, 0, 1, lr_b);
+        cout << "batch size 0 accepted" << endl;
+        failed = 1;
+    }catch(const invalid_argument& e){
+        cout << "batch size 0 refused: " << e.what() << endl;
+    }
+    return failed;
+}
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/memory.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Weight bandwidth of one layer's delta against its forward product, one sample at a time
+// forward   - W * x, a dot product per row of W like FNN::forward
+// strided   - W^T * delta with the old loop order, the inner loop walks down a column of W
+// row-wise  - W^T * delta through gemm as a one-row product, the inner loop walks along rows of W
+// vs fwd is the row-wise bandwidth over the forward one, the delta keeps up when it is at least 1
+
+// ================== Global Variables ==================
+
+#define MIN_MS 200  // every measurement repeats until it has run this long
+
+// ================== Benchmark ==================
+
+// Seconds per call of the fastest of three runs
+template<typename F>
+double time_call(F call){
+    double best = 0;
+    for(int r = 0; r < 3; r++){
+        auto startTime = chrono::high_resolution_clock::now();
+        double elapsed = 0;
+        long long calls = 0;
+        do{
+            call();
+            calls++;
+            elapsed = chrono::duration<double>(chrono::high_resolution_clock::now() - startTime).count();
+        }while(elapsed < MIN_MS / 1000.0);
+        if(r == 0 || elapsed / calls < best) best = elapsed / calls;
+    }
+    return best;
+}
+
+// W is rows x cols, like weights_flat[i+1] with rows = layer_sz[i+2] and cols = layer_sz[i+1]
+void run(int rows, int cols){
+    double* W = aligned_new<double>((size_t)rows * cols, ARENA_ALIGN);
+    double* x = aligned_new<double>(cols, ARENA_ALIGN);
+    double* y = aligned_new<double>(rows, ARENA_ALIGN);
+    double* d = aligned_new<double>(rows, ARENA_ALIGN);
+    double* strided = aligned_new<double>(cols, ARENA_ALIGN);
+    double* rowwise = aligned_new<double>(cols, ARENA_ALIGN);
+    for(size_t i = 0; i < (size_t)rows * cols; i++) W[i] = (rand() % 2000 - 1000) / 1000.0;
+    for(int j = 0; j < cols; j++) x[j] = (rand() % 1000) / 1000.0;
+    for(int k = 0; k < rows; k++) d[k] = (rand() % 2000 - 1000) / 1000.0;
+
+    double fwd = time_call([&]{
+        gemm(false, true, 1, rows, cols, 1.0, x, cols, W, cols, 0.0, y, rows);
+    });
+    double old = time_call([&]{
+        for(int j = 0; j < cols; j++){
+            double sum = 0;
+            for(int k = 0; k < rows; k++){
+                sum += d[k] * W[(size_t)k * cols + j];
+            }
+            strided[j] = sum;
+        }
+    });
+    double row = time_call([&]{
+        gemm(false, false, 1, cols, rows, 1.0, d, rows, W, cols, 0.0, rowwise, cols);
+    });
+
+    double maxDiff = 0;
+    for(int j = 0; j < cols; j++) maxDiff = max(maxDiff, fabs(strided[j] - rowwise[j]));
+
+    double bytes = (double)rows * cols * sizeof(double);
+    cout << setw(14) << (to_string(rows) + "x" + to_string(cols)) << fixed
+         << setw(10) << setprecision(0) << bytes / 1024
+         << setw(12) << setprecision(2) << bytes / fwd / 1e9
+         << setw(12) << bytes / old / 1e9
+         << setw(12) << bytes / row / 1e9
+         << setw(10) << fwd / row
+         << setw(12) << scientific << setprecision(1) << maxDiff << endl;
+
+    aligned_delete(W);
+    aligned_delete(x);
+    aligned_delete(y);
+    aligned_delete(d);
+    aligned_delete(strided);
+    aligned_delete(rowwise);
+}
+
+int main(){
+    srand(SEED);
+    cout << "GB/s of weights read per call" << endl;
+    cout << setw(14) << "weights" << setw(10) << "KB" << setw(12) << "forward" << setw(12) << "strided"
+         << setw(12) << "row-wise" << setw(10) << "vs fwd" << setw(12) << "max diff" << endl;
+
+    run(128, 128);
+    run(512, 512);
+    run(1024, 1024);
+    run(2048, 2048);
+    run(10, 4096);
+    run(4096, 10);
+
+    return 0;
+}
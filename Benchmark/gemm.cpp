@@ -0,0 +1,184 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "../FastNN/kernels.hpp"
+#include "../Implementations/matrix/matrix.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Checks gemm against gemm_ref and Matrix::prod (views included) against Matrix::prod_naive
+// Every case runs each transpose combination and fails the program when an element is off by more than
+// TOLERANCE rounding steps of its own magnitude, i.e. |c - ref| > TOLERANCE * (k + 2) * eps * (|alpha| |A| |B| + |beta| |C|)
+
+// ================== Global Variables ==================
+
+#define TOLERANCE 2
+
+// ================== Checks ==================
+
+int failures = 0;
+
+// Values in [-1, 1)
+template<typename T>
+void fill_random(vector<T>& v){
+    for(size_t i = 0; i < v.size(); i++) v[i] = (rand() % 2000 - 1000) / (T)1000;
+}
+
+// ld is the distance between rows of every operand, at least their width, extra columns hold values gemm must not touch
+template<typename T>
+void check_gemm(const char* type, int m, int n, int k, int pad, T alpha, T beta){
+    double worst = 0;
+    for(int t = 0; t < 4; t++){
+        bool transA = t & 2, transB = t & 1;
+        int lda = (transA ? m : k) + pad;
+        int ldb = (transB ? k : n) + pad;
+        int ldc = n + pad;
+        vector<T> A((size_t)(transA ? k : m) * lda), B((size_t)(transB ? n : k) * ldb), C((size_t)m * ldc);
+        fill_random(A);
+        fill_random(B);
+        fill_random(C);
+        vector<T> ref = C;
+        gemm(transA, transB, m, n, k, alpha, A.data(), lda, B.data(), ldb, beta, C.data(), ldc);
+        gemm_ref(transA, transB, m, n, k, alpha, A.data(), lda, B.data(), ldb, beta, ref.data(), ldc);
+
+        // The same product on absolute values bounds the magnitude the rounding error scales with
+        vector<T> absA = A, absB = B, scale = ref;
+        for(T& x : absA) x = fabs(x);
+        for(T& x : absB) x = fabs(x);
+        for(size_t i = 0; i < scale.size(); i++) scale[i] = fabs(C[i]);
+        gemm_ref(transA, transB, m, n, k, (T)fabs(alpha), absA.data(), lda, absB.data(), ldb, (T)fabs(beta), scale.data(), ldc);
+
+        double eps = numeric_limits<T>::epsilon();
+        for(int i = 0; i < m; i++){
+            for(int j = 0; j < ldc; j++){
+                size_t idx = (size_t)i * ldc + j;
+                double err = fabs((double)C[idx] - ref[idx]);
+                // Past the width nothing may change
+                double bound = j < n ? TOLERANCE * (k + 2) * eps * max((double)scale[idx], 1e-30) : 0;
+                if(err > bound){
+                    if(failures < 10){
+                        cout << "  mismatch " << type << " trans " << transA << transB << " at " << i << "," << j
+                             << ": " << C[idx] << " vs " << ref[idx] << endl;
+                    }
+                    failures++;
+                }
+                if(j < n) worst = max(worst, err / (eps * max((double)scale[idx], 1e-30)));
+            }
+        }
+    }
+    cout << setw(8) << type << setw(6) << m << setw(6) << n << setw(6) << k << setw(6) << pad
+         << setw(8) << alpha << setw(8) << beta << setw(16) << fixed << setprecision(2) << worst << endl;
+    cout.unsetf(ios::fixed);
+}
+
+// Copies any view into its own row-major matrix, so prod_naive can run on it
+Matrix dense(MatrixView v){
+    Matrix res(v.rows(), v.cols(), MATRIX_UNINIT);
+    res = v;
+    return res;
+}
+
+void check_views(const char* name, MatrixView a, MatrixView b){
+    Matrix res(a.rows(), b.cols(), MATRIX_ZERO);
+    Matrix ref(a.rows(), b.cols(), MATRIX_ZERO);
+    prod(a, b, res);
+    Matrix da = dense(a), db = dense(b);
+    da.prod_naive(db, ref);
+
+    double worst = 0;
+    double eps = numeric_limits<double>::epsilon();
+    for(int i = 0; i < a.rows(); i++){
+        for(int j = 0; j < b.cols(); j++){
+            double scale = 0;
+            for(int p = 0; p < a.cols(); p++) scale += fabs(a.at(i, p) * b.at(p, j));
+            double err = fabs(res.at(i, j) - ref.at(i, j));
+            if(err > TOLERANCE * (a.cols() + 2) * eps * max(scale, 1e-30)){
+                if(failures < 10) cout << "  mismatch " << name << " at " << i << "," << j << endl;
+                failures++;
+            }
+            worst = max(worst, err / (eps * max(scale, 1e-30)));
+        }
+    }
+    cout << setw(24) << name << setw(6) << a.rows() << setw(6) << b.cols() << setw(6) << a.cols()
+         << setw(16) << fixed << setprecision(2) << worst << endl;
+    cout.unsetf(ios::fixed);
+}
+
+// Matrix::prod with each transpose flag against prod_naive with the same one
+void check_matrix(int n, int k, int m){
+    double worst = 0;
+    double eps = numeric_limits<double>::epsilon();
+    for(int t = 0; t < 4; t++){
+        Matrix a(t & 2 ? k : n, t & 2 ? n : k);
+        Matrix b(t & 1 ? m : k, t & 1 ? k : m);
+        Matrix res(n, m, MATRIX_ZERO), ref(n, m, MATRIX_ZERO);
+        a.prod(b, res, t);
+        a.prod_naive(b, ref, t);
+        // Entries are in [0, 10), so every product term is positive and the sum is its own scale
+        for(int i = 0; i < n; i++){
+            for(int j = 0; j < m; j++){
+                double scale = max(fabs(ref(i, j)), 1e-30);
+                double err = fabs(res(i, j) - ref(i, j));
+                if(err > TOLERANCE * (k + 2) * eps * scale){
+                    if(failures < 10) cout << "  mismatch Matrix::prod transpose " << t << " at " << i << "," << j << endl;
+                    failures++;
+                }
+                worst = max(worst, err / (eps * scale));
+            }
+        }
+    }
+    cout << setw(24) << "Matrix::prod" << setw(6) << n << setw(6) << m << setw(6) << k
+         << setw(16) << fixed << setprecision(2) << worst << endl;
+    cout.unsetf(ios::fixed);
+}
+
+int main(){
+    srand(SEED);
+
+    cout << "gemm against gemm_ref, all four transposes, worst error in rounding steps" << endl;
+    cout << setw(8) << "type" << setw(6) << "m" << setw(6) << "n" << setw(6) << "k" << setw(6) << "pad"
+         << setw(8) << "alpha" << setw(8) << "beta" << setw(16) << "worst" << endl;
+    // Thin products that skip packing: m < MR, n < NR, a matrix-vector product
+    // Packed ones: edge tiles in both directions, k crossing one and two KC blocks without being a multiple
+    int shapes[][3] = {{3, 5, 7}, {1, 300, 129}, {300, 1, 129}, {2, 40, 64}, {40, 7, 64},
+                       {37, 45, 300}, {130, 67, 517}, {97, 19, 257}, {4, 8, 1}};
+    for(auto& s : shapes){
+        for(int pad : {0, 5}){
+            check_gemm<double>("double", s[0], s[1], s[2], pad, 1.0, 0.0);
+            check_gemm<float>("float", s[0], s[1], s[2], pad, 1.0f, 0.0f);
+        }
+        check_gemm<double>("double", s[0], s[1], s[2], 3, -0.5, 1.0);
+        check_gemm<float>("float", s[0], s[1], s[2], 3, 0.75f, -2.0f);
+    }
+
+    cout << endl << "Matrix products against prod_naive" << endl;
+    cout << setw(24) << "operands" << setw(6) << "m" << setw(6) << "n" << setw(6) << "k" << setw(16) << "worst" << endl;
+    check_matrix(3, 5, 7);
+    check_matrix(130, 517, 67);
+
+    // Views of a bigger buffer with every stride pattern prod has to handle
+    Matrix big(160, 600);
+    Matrix other(600, 160);
+    MatrixView inner = big.block(3, 7, 130, 517);          // ld wider than the block
+    MatrixView innerT = other.block(5, 2, 517, 130).t();   // unit row stride, gemm reads it transposed
+    MatrixView right = other.block(1, 3, 517, 67);
+    MatrixView every_other(big.view().data, 80, 300, 2 * 600, 2); // no unit stride at all, dot product fallback
+    check_views("block * block", inner, right);
+    check_views("transposed * block", innerT, right);
+    check_views("block * transposed", inner, big.block(0, 0, 67, 517).t());
+    check_views("strided * block", every_other, other.block(0, 0, 300, 9));
+    check_views("row * block", big.row(11).block(0, 0, 1, 517), right);
+    check_views("block * column", inner, other.col(4).block(0, 0, 517, 1));
+
+    if(failures > 0){
+        cout << failures << " mismatches" << endl;
+        return 1;
+    }
+    cout << "all match" << endl;
+    return 0;
+}
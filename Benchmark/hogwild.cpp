@@ -0,0 +1,68 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+
+#include "../FastNN/FNN.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Samples/sec of train_parallel from 1 thread up to every core
+// The max thread count can be passed as the first argument
+
+// ================== Global Variables ==================
+
+#define EPOCHS 50
+
+// ================== Benchmark ==================
+
+double base = 0;
+
+void run(int threads, Data_Entry<double>* training_data, int training_n, Data_Entry<double>* testing_data, int testing_n){
+    srand(SEED);
+    int layer_sz[] = {2, 20, 20, 2};
+    double lr = 1;
+    FNN<double> nn(3, layer_sz, _sigmoid, lr);
+
+    auto startTime = chrono::high_resolution_clock::now();
+    nn.train_parallel(training_data, training_n, EPOCHS, lr, threads);
+    auto endTime = chrono::high_resolution_clock::now();
+    double rate = (double)EPOCHS * training_n / chrono::duration<double>(endTime - startTime).count();
+    if(threads == 1) base = rate;
+
+    double loss = 0;
+    for(int i = 0; i < testing_n; i++){
+        loss += nn.loss(nn.forward(testing_data[i].first), testing_data[i].second);
+    }
+
+    cout << setw(10) << threads << fixed
+         << setw(14) << setprecision(0) << rate
+         << setw(10) << setprecision(2) << rate / base
+         << setw(12) << setprecision(6) << loss / testing_n << endl;
+}
+
+int main(int argc, char** argv){
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int)thread::hardware_concurrency();
+    if(max_threads < 1) max_threads = 1;
+
+    srand(SEED);
+    int training_n = 4000;
+    Data_Entry<double>* training_data = getCircleData<double>(training_n, 10, 10, 3, 4, 2);
+    int testing_n = 1000;
+    Data_Entry<double>* testing_data = getCircleData<double>(testing_n, 10, 10, 3, 4, 2);
+
+    cout << setw(10) << "threads" << setw(14) << "samples/s" << setw(10) << "speedup" << setw(12) << "loss" << endl;
+
+    int threads = 1;
+    for(; threads <= max_threads; threads *= 2){
+        run(threads, training_data, training_n, testing_data, testing_n);
+    }
+    if(threads / 2 != max_threads){
+        run(max_threads, training_data, training_n, testing_data, testing_n);
+    }
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <cstddef>
+
+#include "../FastNN/FNN.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Saves a model, maps it back with load_mmap and checks the outputs match bit for bit
+// Also shows a corrupted file being rejected
+
+// ================== Global Variables ==================
+
+#define PATH "model.fnn"
+#define SAMPLES 1000
+
+// ================== Benchmark ==================
+
+int failed = 0;
+
+// Saves a fresh small model and overwrites n bytes at offset
+void corrupt(long offset, const void* value, size_t n){
+    srand(SEED);
+    int layer_sz[] = {2, 20, 20, 2};
+    FNN<double> nn(3, layer_sz, _sigmoid, 1);
+    nn.save(PATH);
+    FILE* f = fopen(PATH, "r+b");
+    fseek(f, offset, SEEK_SET);
+    fwrite(value, 1, n, f);
+    fclose(f);
+}
+
+// Loading has to throw, without the checksum when verify is off
+void expect_rejected(const string& what, bool verify){
+    try{
+        FNN<double>::load_mmap(PATH, verify);
+        cout << what << " loaded" << endl;
+        failed = 1;
+    }catch(const runtime_error& e){
+        cout << what << " rejected: " << e.what() << endl;
+    }
+}
+
+void run(int layer_n, int* layer_sz){
+    srand(SEED);
+    int in = layer_sz[0], out = layer_sz[layer_n];
+    FNN<double> nn(layer_n, layer_sz, _sigmoid, 1);
+
+    double* inputs = new double[(size_t)SAMPLES * in];
+    for(size_t i = 0; i < (size_t)SAMPLES * in; i++){
+        inputs[i] = (rand() % 1000) / 100.0;
+    }
+    double* expected = new double[(size_t)SAMPLES * out];
+    double* got = new double[(size_t)SAMPLES * out];
+    nn.forward_batch(inputs, SAMPLES, expected);
+
+    auto startTime = chrono::high_resolution_clock::now();
+    nn.save(PATH);
+    auto endTime = chrono::high_resolution_clock::now();
+    double save_ms = chrono::duration<double, milli>(endTime - startTime).count();
+
+    double load_us[2];
+    bool same = true;
+    for(int verify = 1; verify >= 0; verify--){
+        startTime = chrono::high_resolution_clock::now();
+        FNN<double> loaded = FNN<double>::load_mmap(PATH, verify);
+        endTime = chrono::high_resolution_clock::now();
+        load_us[verify] = chrono::duration<double, micro>(endTime - startTime).count();
+
+        loaded.forward_batch(inputs, SAMPLES, got);
+        for(size_t i = 0; i < (size_t)SAMPLES * out; i++){
+            same = same && got[i] == expected[i];
+        }
+    }
+    if(!same) failed = 1;
+
+    string topology;
+    for(int i = 0; i <= layer_n; i++){
+        topology += (i ? "-" : "") + to_string(i == 0 ? in : layer_sz[i]);
+    }
+    cout << setw(20) << topology << fixed
+         << setw(12) << setprecision(1) << nn.model_size() / 1024.0
+         << setw(10) << setprecision(2) << save_ms
+         << setw(12) << setprecision(1) << load_us[1]
+         << setw(12) << setprecision(1) << load_us[0]
+         << setw(10) << (same ? "yes" : "NO") << endl;
+
+    delete[] inputs;
+    delete[] expected;
+    delete[] got;
+}
+
+int main(){
+    cout << setw(20) << "topology" << setw(12) << "KiB" << setw(10) << "save ms" << setw(12) << "load us" << setw(12) << "no verify" << setw(10) << "same" << endl;
+
+    int small[] = {2, 20, 20, 2};
+    run(3, small);
+    int wide[] = {32, 512, 512, 512, 10};
+    run(4, wide);
+    int huge[] = {256, 2048, 2048, 10};
+    run(3, huge);
+
+    // Flip one weight byte, the checksum has to catch it
+    FILE* f = fopen(PATH, "r+b");
+    fseek(f, -100, SEEK_END);
+    int c = fgetc(f);
+    fseek(f, -100, SEEK_END);
+    fputc(c ^ 1, f);
+    fclose(f);
+    expect_rejected("corrupted file", true);
+
+    // The checksum covers the header, a changed lr is caught like a changed weight
+    double lr = 2;
+    corrupt(offsetof(ModelHeader, lr), &lr, sizeof(lr));
+    expect_rejected("changed lr", true);
+
+    // Forged sizes are caught by the bounds checks alone
+    uint32_t layer_n = 1 << 30;
+    corrupt(offsetof(ModelHeader, layer_n), &layer_n, sizeof(layer_n));
+    expect_rejected("huge layer count", false);
+    uint32_t sizes[] = {0x7ffffff0u, 0x7ffffff0u};
+    corrupt(sizeof(ModelHeader) + sizeof(uint32_t), sizes, sizeof(sizes));
+    expect_rejected("overflowing layer sizes", false);
+    uint32_t activation = 7;
+    corrupt(offsetof(ModelHeader, activation), &activation, sizeof(activation));
+    expect_rejected("unknown activation", false);
+
+    remove(PATH);
+    return failed;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono>
+
+#include "../FastNN/FNN.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Time-to-loss of FNN<float> against FNN<double> on the circle dataset
+
+// ================== Global Variables ==================
+
+#define TARGET_LOSS 0.05
+#define MAX_EPOCHS 3000
+#define EPOCH_STEP 10
+
+#define BATCH_SIZE 16
+
+// ================== Data ==================
+
+template<typename T>
+double test_loss(FNN<T>& nn, Data_Entry<T>* data, int n){
+    double res = 0;
+    for(int i = 0; i < n; i++){
+        res += nn.loss(nn.forward(data[i].first), data[i].second);
+    }
+    return res / n;
+}
+
+// ================== Benchmark ==================
+
+// Trains until the test loss drops below TARGET_LOSS, only training time is counted
+template<typename T>
+void run(const char* name, int batch_size, double lr){
+    srand(SEED);
+    int layer_n = 3;
+    int layer_sz[] = {2, 20, 20, 2};
+    FNN<T> nn(layer_n, layer_sz, _sigmoid, lr);
+
+    int training_n = 1000;
+    Data_Entry<T>* training_data = getCircleData<T>(training_n, 10, 10, 3, 4, 2);
+    int testing_n = 1000;
+    Data_Entry<T>* testing_data = getCircleData<T>(testing_n, 10, 10, 3, 4, 2);
+
+    double ms = 0;
+    double loss = test_loss(nn, testing_data, testing_n);
+    int epochs = 0;
+    while(loss > TARGET_LOSS && epochs < MAX_EPOCHS){
+        auto startTime = chrono::high_resolution_clock::now();
+        if(batch_size == 1) nn.train(training_data, training_n, EPOCH_STEP, lr);
+        else                nn.train_batch(training_data, training_n, batch_size, EPOCH_STEP, lr);
+        auto endTime = chrono::high_resolution_clock::now();
+        ms += chrono::duration<double, milli>(endTime - startTime).count();
+
+        epochs += EPOCH_STEP;
+        loss = test_loss(nn, testing_data, testing_n);
+    }
+
+    cout << setw(8) << name << setw(8) << batch_size
+         << setw(10) << epochs << setw(12) << fixed << setprecision(4) << loss
+         << setw(12) << setprecision(1) << ms
+         << setw(12) << setprecision(3) << ms / epochs
+         << (loss > TARGET_LOSS ? "  (target not reached)" : "") << endl;
+}
+
+int main(){
+    cout << "target loss " << TARGET_LOSS << ", kernels: " << act_kernels<float>().name << endl;
+    cout << setw(8) << "type" << setw(8) << "batch" << setw(10) << "epochs" << setw(12) << "loss"
+         << setw(12) << "total ms" << setw(12) << "ms/epoch" << endl;
+
+    run<double>("double", 1, 1);
+    run<float>("float", 1, 1);
+    run<double>("double", BATCH_SIZE, 4);
+    run<float>("float", BATCH_SIZE, 4);
+
+    return 0;
+}
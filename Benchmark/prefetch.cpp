@@ -0,0 +1,156 @@
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/dataset.hpp"
+#include "../FastNN/dataset_file.hpp"
+#include "../FastNN/prefetch.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// train_batch with the batches assembled inline against the same batches built by a BatchPrefetcher
+// on its own thread, from memory and from a dataset file. The stall counters say which side waits
+
+// ================== Global Variables ==================
+
+#define SAMPLES 100000
+#define FEATURES 64
+#define EPOCHS 2
+#define BATCH_SIZE 64
+#define SHUFFLE_ROWS 4096
+#define PATH "prefetch.fnnd"
+
+// ================== Data ==================
+
+// Inside when the first 8 features sum past their mean
+Dataset<float> getSumData(int n, int features){
+    Dataset<float> res(n, features, 2, SEED);
+    for(int i = 0; i < n; i++){
+        float* input = res.input(i);
+        float sum = 0;
+        for(int k = 0; k < features; k++){
+            input[k] = (rand() % 1000) / 1000.0f;
+            if(k < 8) sum += input[k];
+        }
+        float* output = res.target(i);
+        output[0] = sum > 4 ? 1 : 0;
+        output[1] = sum > 4 ? 0 : 1;
+    }
+    return res;
+}
+
+// ================== Utils ==================
+
+bool same_weights(FNN<float>& a, FNN<float>& b){
+    for(int i = 0; i < a.layer_n; i++){
+        size_t sz = (size_t)a.layer_sz[i+1] * a.layer_sz[i] * sizeof(float);
+        if(memcmp(a.weights_flat[i], b.weights_flat[i], sz) != 0) return false;
+    }
+    return true;
+}
+
+double ms_since(chrono::high_resolution_clock::time_point start){
+    return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// ================== Benchmark ==================
+
+int main(){
+    int failed = 0;
+    int sz_a[] = {FEATURES, 32, 2};
+    int sz_b[] = {FEATURES, 32, 2};
+    int sz_c[] = {FEATURES, 32, 2};
+    int sz_d[] = {FEATURES, 32, 2};
+    cout << fixed << setprecision(1);
+
+    srand(SEED);
+    Dataset<float> data_a = getSumData(SAMPLES, FEATURES);
+    Dataset<float> data_b(SAMPLES, FEATURES, 2, SEED);
+    memcpy(data_b.inputs, data_a.inputs, (size_t)SAMPLES * FEATURES * sizeof(float));
+    memcpy(data_b.targets, data_a.targets, (size_t)SAMPLES * 2 * sizeof(float));
+    save_dataset(PATH, data_a);
+
+    // Inline, the reference
+    srand(SEED);
+    double lr_a = 1;
+    FNN<float> a(2, sz_a, _sigmoid, lr_a);
+    auto start = chrono::high_resolution_clock::now();
+    a.train_batch(data_a, BATCH_SIZE, EPOCHS, lr_a, true);
+    cout << "inline:     " << ms_since(start) / EPOCHS << " ms/epoch" << endl;
+
+    // Same shuffles from a copy of the data, so the weights have to match
+    srand(SEED);
+    double lr_b = 1;
+    FNN<float> b(2, sz_b, _sigmoid, lr_b);
+    {
+        BatchPrefetcher<float> feed(data_b, BATCH_SIZE, true);
+        start = chrono::high_resolution_clock::now();
+        b.train_batch(feed, EPOCHS, lr_b);
+        cout << "prefetched: " << ms_since(start) / EPOCHS << " ms/epoch, " << feed.report() << endl;
+    }
+    bool same = same_weights(a, b);
+    cout << "same weights as inline: " << (same ? "yes" : "NO") << endl;
+    if(!same) failed = 1;
+
+    // Normalized on the producer thread
+    srand(SEED);
+    double lr_c = 1;
+    FNN<float> c(2, sz_c, _sigmoid, lr_c);
+    {
+        float mean[FEATURES], scale[FEATURES];
+        for(int k = 0; k < FEATURES; k++){
+            mean[k] = 0.5f;
+            scale[k] = 3.46f; // 1 / stddev of uniform [0, 1)
+        }
+        BatchPrefetcher<float> feed(data_b, BATCH_SIZE, true);
+        feed.normalize(mean, scale);
+        start = chrono::high_resolution_clock::now();
+        c.train_batch(feed, EPOCHS, lr_c);
+        cout << "normalized: " << ms_since(start) / EPOCHS << " ms/epoch, " << feed.report() << endl;
+    }
+
+    // From the file through a shuffle buffer
+    srand(SEED);
+    double lr_d = 1;
+    FNN<float> d(2, sz_d, _sigmoid, lr_d);
+    {
+        DatasetStream<float> stream(PATH, SHUFFLE_ROWS, SEED);
+        BatchPrefetcher<float> feed(stream, BATCH_SIZE);
+        start = chrono::high_resolution_clock::now();
+        d.train_batch(feed, EPOCHS, lr_d);
+        cout << "streamed:   " << ms_since(start) / EPOCHS << " ms/epoch, " << feed.report() << endl;
+        cout << "            " << stream.throughput() << endl;
+        if(stream.samples != (long long)SAMPLES * EPOCHS) failed = 1;
+    }
+
+    // A source of the wrong width is refused before anything is copied
+    {
+        int sz_e[] = {FEATURES + 1, 32, 2};
+        double lr_e = 1;
+        FNN<float> e(2, sz_e, _sigmoid, lr_e);
+        BatchPrefetcher<float> feed(data_b, BATCH_SIZE);
+        try{
+            e.train_batch(feed, EPOCHS, lr_e);
+            cout << "wrong width accepted" << endl;
+            failed = 1;
+        }catch(const invalid_argument& err){
+            cout << "wrong width refused: " << err.what() << endl;
+        }
+    }
+
+    // Abandoned after one batch, the producer is left waiting for a spare buffer and the destructor has to stop it
+    {
+        BatchPrefetcher<float> feed(data_b, BATCH_SIZE);
+        feed.start(EPOCHS);
+        feed.acquire();
+    }
+    cout << "abandoned prefetcher stopped" << endl;
+
+    remove(PATH);
+    return failed;
+}
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/dataset.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Where the time of one training run goes, per layer and phase, from the counters built in with -DFNN_PROFILE
+// Phases with low flops/cycle and high bytes/cycle are bound by memory, the reverse by compute
+
+// ================== Global Variables ==================
+
+#define SAMPLES 2000
+#define EPOCHS 3
+#define BATCH 64
+
+// ================== Benchmark ==================
+
+// Points in [0, 10)^in, inside when within 3 of the centre of the cube
+void fill(Dataset<double>& data){
+    for(int i = 0; i < data.n; i++){
+        double* x = data.input(i);
+        double dist = 0;
+        for(int k = 0; k < data.in; k++){
+            x[k] = (rand() % 1000) / 100.0;
+            dist += (x[k] - 5) * (x[k] - 5);
+        }
+        bool inside = sqrt(dist) <= 3;
+        data.target(i)[0] = inside ? 1 : 0;
+        data.target(i)[1] = inside ? 0 : 1;
+    }
+}
+
+int main(){
+    srand(SEED);
+    int layer_sz[] = {32, 512, 256, 64, 2};
+    FNN<double> nn(4, layer_sz, _sigmoid, 0.1);
+    if(nn.stats() == nullptr){
+        cout << nn.stats_report();
+        return 1;
+    }
+
+    Dataset<double> data(SAMPLES, 32, 2, SEED);
+    fill(data);
+
+    double lr = 0.1;
+    nn.train(data, EPOCHS, lr);
+    cout << "train, " << EPOCHS << " epochs of " << SAMPLES << " samples one at a time" << endl;
+    cout << nn.stats_report() << endl;
+
+    nn.reset_stats();
+    nn.reserve_batch(BATCH);
+    nn.train_batch(data, BATCH, EPOCHS, lr);
+    cout << "train_batch, " << EPOCHS << " epochs of " << SAMPLES << " samples in batches of " << BATCH << endl;
+    cout << nn.stats_report();
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono>
+
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/QFNN.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Accuracy and inference speed of QuantizedFNN against the float model it came from
+
+// ================== Global Variables ==================
+
+#define CALIBRATION_N 200
+#define FORWARD_REPS 20
+#define INIT_SCALE 4
+
+// ================== Benchmark ==================
+
+template<typename Model>
+double forward_ns(Model& nn, Data_Entry<float>* data, int n){
+    volatile float sink = 0;
+    auto startTime = chrono::high_resolution_clock::now();
+    for(int r = 0; r < FORWARD_REPS; r++){
+        for(int i = 0; i < n; i++){
+            sink = sink + nn.forward(data[i].first)[0];
+        }
+    }
+    auto endTime = chrono::high_resolution_clock::now();
+    return chrono::duration<double, nano>(endTime - startTime).count() / FORWARD_REPS / n;
+}
+
+// The default weights are all in [0, 1), which saturates every sigmoid of a wide layer and stops it from learning
+// Centred weights scaled by 1 / sqrt(inputs) keep the sums of any width around the same size
+void scale_init(FNN<float>& nn){
+    for(int i = 0; i < nn.layer_n; i++){
+        float scale = INIT_SCALE / sqrt((float)nn.layer_sz[i]);
+        size_t sz = (size_t)nn.layer_sz[i+1] * nn.layer_sz[i];
+        for(size_t k = 0; k < sz; k++) nn.weights_flat[i][k] = (nn.weights_flat[i][k] - 0.5f) * scale;
+    }
+}
+
+// Layer 0's bias against inputs calibrated on a range much wider than the bias itself
+// A zero input quantizes to all zeros, so the first layer sums are the bias alone and have to match exactly
+bool bias_check(){
+    srand(SEED);
+    int layer_sz[] = {2, 20, 20, 2};
+    FNN<float> nn(3, layer_sz, _sigmoid, 1);
+    Data_Entry<float>* wide_data = getCircleData<float>(CALIBRATION_N, 1000, 1000, 300, 400, 200);
+    QuantizedFNN<float> qnn(nn, wide_data, CALIBRATION_N);
+
+    float zero[] = {0, 0};
+    nn.forward(zero);
+    qnn.forward(zero);
+    double err = 0;
+    for(int j = 0; j < layer_sz[1]; j++){
+        err = max(err, (double)fabs(nn.beforeActivation[0][j] - qnn.beforeActivation[0][j]));
+    }
+    cout << "layer 0 bias error, inputs calibrated up to 1000: " << err << endl << endl;
+    return err == 0;
+}
+
+void run(int layer_n, int* layer_sz, int epochs, double lr){
+    srand(SEED);
+    cout << "topology:";
+    for(int i = 0; i <= layer_n; i++) cout << " " << layer_sz[i];
+    cout << endl;
+    FNN<float> nn(layer_n, layer_sz, _sigmoid, lr);
+    scale_init(nn);
+
+    int training_n = 1000;
+    Data_Entry<float>* training_data = getCircleData<float>(training_n, 10, 10, 3, 4, 2);
+    int testing_n = 1000;
+    Data_Entry<float>* testing_data = getCircleData<float>(testing_n, 10, 10, 3, 4, 2);
+
+    nn.train(training_data, training_n, epochs, lr);
+
+    QuantizedFNN<float> qnn(nn, training_data, CALIBRATION_N);
+    cout << to_string(qnn.compare(nn, testing_data, testing_n)) << endl;
+
+    double f = forward_ns(nn, testing_data, testing_n);
+    double q = forward_ns(qnn, testing_data, testing_n);
+    cout << fixed << setprecision(1) << "forward: " << f << " ns -> " << q << " ns (" << setprecision(2) << f / q << "x)" << endl;
+    cout << endl;
+}
+
+int main(){
+    int failed = 0;
+    if(!bias_check()) failed = 1;
+
+    int small[] = {2, 20, 20, 2};
+    run(3, small, 300, 1);
+
+    int wide[] = {2, 300, 300, 300, 2};
+    run(4, wide, 60, 0.1);
+
+    return failed;
+}
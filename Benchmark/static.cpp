@@ -0,0 +1,62 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono>
+
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/StaticFNN.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// FNN against StaticFNN with the same topology, seed and data
+
+// ================== Global Variables ==================
+
+#define EPOCHS 100
+
+// ================== Benchmark ==================
+
+template<typename Model>
+void run(const char* name, Model& nn, Data_Entry<double>* training_data, int training_n, Data_Entry<double>* testing_data, int testing_n){
+    double lr = 1;
+    auto startTime = chrono::high_resolution_clock::now();
+    nn.train(training_data, training_n, EPOCHS, lr);
+    auto endTime = chrono::high_resolution_clock::now();
+    double ms = chrono::duration<double, milli>(endTime - startTime).count();
+
+    double loss = 0;
+    startTime = chrono::high_resolution_clock::now();
+    for(int i = 0; i < testing_n; i++){
+        loss += nn.loss(nn.forward(testing_data[i].first), testing_data[i].second);
+    }
+    endTime = chrono::high_resolution_clock::now();
+    double fwd = chrono::duration<double, nano>(endTime - startTime).count() / testing_n;
+
+    cout << setw(10) << name << fixed
+         << setw(12) << setprecision(1) << ms
+         << setw(14) << setprecision(1) << ms * 1e6 / ((double)EPOCHS * training_n)
+         << setw(12) << setprecision(1) << fwd
+         << setw(12) << setprecision(6) << loss / testing_n << endl;
+}
+
+int main(){
+    srand(SEED);
+    int training_n = 1000;
+    Data_Entry<double>* training_data = getCircleData<double>(training_n, 10, 10, 3, 4, 2);
+    int testing_n = 1000;
+    Data_Entry<double>* testing_data = getCircleData<double>(testing_n, 10, 10, 3, 4, 2);
+
+    cout << setw(10) << "model" << setw(12) << "train ms" << setw(14) << "ns/sample" << setw(12) << "fwd ns" << setw(12) << "loss" << endl;
+
+    srand(SEED);
+    int layer_sz[] = {2, 20, 20, 2};
+    FNN<double> nn(3, layer_sz, _sigmoid, 1);
+    run("FNN", nn, training_data, training_n, testing_data, testing_n);
+
+    srand(SEED);
+    StaticFNN<2, 20, 20, 2> snn(_sigmoid, 1);
+    run("StaticFNN", snn, training_data, training_n, testing_data, testing_n);
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/dataset.hpp"
+#include "../FastNN/dataset_file.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Trains from a dataset file through DatasetStream and checks it against the same data in memory
+// Every pass starts with the file evicted from the page cache, so the I/O numbers are from the disk
+
+// ================== Global Variables ==================
+
+#define SAMPLES 200000
+#define FEATURES 64
+#define SHUFFLE_ROWS 4096
+#define BATCH_SIZE 64
+#define PATH "stream.fnnd"
+
+// ================== Data ==================
+
+// Inside when the first 8 features sum past their mean
+Dataset<float> getSumData(int n, int features){
+    Dataset<float> res(n, features, 2, SEED);
+    for(int i = 0; i < n; i++){
+        float* input = res.input(i);
+        float sum = 0;
+        for(int k = 0; k < features; k++){
+            input[k] = (rand() % 1000) / 1000.0f;
+            if(k < 8) sum += input[k];
+        }
+        float* output = res.target(i);
+        output[0] = sum > 4 ? 1 : 0;
+        output[1] = sum > 4 ? 0 : 1;
+    }
+    return res;
+}
+
+// ================== Utils ==================
+
+void drop_cache(const char* path){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+long rss_kb(){
+    ifstream status("/proc/self/status");
+    string line;
+    while(getline(status, line)){
+        if(line.compare(0, 6, "VmRSS:") == 0) return atol(line.c_str() + 6);
+    }
+    return 0;
+}
+
+bool same_weights(FNN<float>& a, FNN<float>& b){
+    for(int i = 0; i < a.layer_n; i++){
+        size_t sz = (size_t)a.layer_sz[i+1] * a.layer_sz[i] * sizeof(float);
+        if(memcmp(a.weights_flat[i], b.weights_flat[i], sz) != 0) return false;
+    }
+    return true;
+}
+
+double ms_since(chrono::high_resolution_clock::time_point start){
+    return chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// A hand-written header whose offsets are recomputed from its own n and widths, so they agree with each other
+// even when n * width wraps around, padded out to the size it claims. Opening it has to throw
+bool forged_rejected(const string& what, uint64_t n, uint32_t in, uint32_t out){
+    DatasetHeader h = dataset_header<float>(n, in, out);
+    h.in = in;
+    h.out = out;
+    FILE* f = fopen(PATH, "wb");
+    fwrite(&h, sizeof(h), 1, f);
+    for(uint64_t i = sizeof(h); i < max<uint64_t>(h.file_size, DATASET_ALIGN); i++) fputc(0, f);
+    fclose(f);
+    try{
+        DatasetStream<float> stream(PATH);
+        cout << what << " opened" << endl;
+        return false;
+    }catch(const runtime_error& e){
+        cout << what << " rejected: " << e.what() << endl;
+        return true;
+    }
+}
+
+// ================== Benchmark ==================
+
+int main(){
+    int failed = 0;
+    int sz_a[] = {FEATURES, 32, 2};
+    int sz_b[] = {FEATURES, 32, 2};
+    int sz_c[] = {FEATURES, 32, 2};
+    cout << fixed << setprecision(1);
+
+    // In memory, the reference
+    srand(SEED);
+    double lr_a = 0.1;
+    FNN<float> a(2, sz_a, _sigmoid, lr_a);
+    {
+        Dataset<float> data = getSumData(SAMPLES, FEATURES);
+        save_dataset(PATH, data);
+        cout << SAMPLES << " samples of " << FEATURES << " features, " << data.bytes() / 1e6 << " MB" << endl;
+        auto start = chrono::high_resolution_clock::now();
+        a.train(data, 1, lr_a);
+        cout << "in memory: " << ms_since(start) << " ms" << endl;
+    }
+
+    // Streamed in file order, has to match the in-memory run exactly
+    srand(SEED);
+    double lr_b = 0.1;
+    FNN<float> b(2, sz_b, _sigmoid, lr_b);
+    long rss_before = rss_kb();
+    {
+        DatasetStream<float> stream(PATH);
+        drop_cache(PATH);
+        auto start = chrono::high_resolution_clock::now();
+        b.train(stream, 1, lr_b);
+        cout << "streamed: " << ms_since(start) << " ms, " << stream.throughput() << endl;
+        cout << "resident growth while streaming: " << (rss_kb() - rss_before) / 1024.0 << " MB" << endl;
+    }
+    bool same = same_weights(a, b);
+    cout << "same weights as in memory: " << (same ? "yes" : "NO") << endl;
+    if(!same) failed = 1;
+
+    // Shuffle buffer and mini-batches
+    srand(SEED);
+    double lr_c = 1;
+    FNN<float> c(2, sz_c, _sigmoid, lr_c);
+    {
+        DatasetStream<float> stream(PATH, SHUFFLE_ROWS, SEED);
+        drop_cache(PATH);
+        auto start = chrono::high_resolution_clock::now();
+        c.train_batch(stream, BATCH_SIZE, 1, lr_c);
+        cout << "shuffled batches: " << ms_since(start) << " ms, " << stream.throughput() << endl;
+        if(stream.samples != SAMPLES){
+            cout << "expected " << SAMPLES << " samples, got " << stream.samples << endl;
+            failed = 1;
+        }
+    }
+
+    // n * in and n * out both wrap to 0, the offsets then describe a one page file
+    if(!forged_rejected("wrapping row count", 1ull << 58, 64, 64)) failed = 1;
+    if(!forged_rejected("zero input width", 10, 0, 2)) failed = 1;
+    if(!forged_rejected("width past INT_MAX", 0, 0x80000000u, 2)) failed = 1;
+
+    remove(PATH);
+    return failed;
+}
@@ -0,0 +1,296 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "../FastNN/FNN.hpp"
+#include "../FastNN/dataset.hpp"
+#include "common.hpp"
+#include "suite.hpp"
+
+using namespace std;
+
+// Every implementation on the same seeded data over a grid of topologies and batch sizes
+// Each cell runs in a forked process, so globals start fresh and the peak RSS is the cell's own
+// Results go to a JSON file, one result per line, and are compared against a baseline written the same way
+//
+// ./suite [--quick] [--out suite.json] [--baseline suite_baseline.json] [--threshold 0.1]
+
+// ================== Global Variables ==================
+
+#define SAMPLES 500
+#define LR 0.1
+#define MIN_MS 100          // every timing repeats whole epochs until it has run this long
+#define REPEATS 3           // and keeps the fastest of this many, the slower ones were interrupted
+#define THRESHOLD 0.1       // slower than the baseline by more than this is a regression
+#define BASELINE "suite_baseline.json"
+
+// ================== FNN ==================
+
+static FNN<double>* fnn_nn;
+static Dataset<double>* fnn_data;
+static int fnn_batch;
+static double* fnn_outputs;
+
+static bool fnn_setup(const vector<int>& sizes, int batch, const double* inputs, const double* targets, int n){
+    int in = sizes.front(), out = sizes.back();
+    int* layer_sz = new int[sizes.size()];
+    for(size_t i = 0; i < sizes.size(); i++) layer_sz[i] = sizes[i];
+    double lr = LR;
+    fnn_nn = new FNN<double>(sizes.size() - 1, layer_sz, _sigmoid, lr);
+    fnn_data = new Dataset<double>(n, in, out, SEED);
+    memcpy(fnn_data->inputs, inputs, (size_t)n * in * sizeof(double));
+    memcpy(fnn_data->targets, targets, (size_t)n * out * sizeof(double));
+    fnn_batch = batch;
+    fnn_outputs = new double[(size_t)n * out];
+    if(batch > 1) fnn_nn->reserve_batch(batch);
+    return true;
+}
+
+// Batched cells score with forward_batch, the others one sample at a time
+static double fnn_forward_all(){
+    double sum = 0;
+    if(fnn_batch > 1){
+        fnn_nn->forward_batch(fnn_data->inputs, fnn_data->n, fnn_outputs);
+        for(int i = 0; i < fnn_data->n; i++) sum += fnn_outputs[(size_t)i * fnn_data->out];
+        return sum;
+    }
+    for(int i = 0; i < fnn_data->n; i++) sum += fnn_nn->forward(fnn_data->input(i))[0];
+    return sum;
+}
+
+static void fnn_train_epoch(double lr){
+    if(fnn_batch > 1) fnn_nn->train_batch(*fnn_data, fnn_batch, 1, lr);
+    else fnn_nn->train(*fnn_data, 1, lr);
+}
+
+Variant fnn_variant = {"fnn", fnn_setup, fnn_forward_all, fnn_train_epoch};
+
+// ================== Data ==================
+
+// Points in [0, 10)^in, inside when within 3 of the centre of the cube
+void getSphereData(int n, int in, int out, vector<double>& inputs, vector<double>& targets){
+    inputs.assign((size_t)n * in, 0);
+    targets.assign((size_t)n * out, 0);
+    for(int i = 0; i < n; i++){
+        double dist = 0;
+        for(int k = 0; k < in; k++){
+            double v = (rand() % 1000) / 100.0;
+            inputs[(size_t)i * in + k] = v;
+            dist += (v - 5) * (v - 5);
+        }
+        bool inside = sqrt(dist) <= 3;
+        targets[(size_t)i * out] = inside ? 1 : 0;
+        if(out > 1) targets[(size_t)i * out + 1] = inside ? 0 : 1;
+    }
+}
+
+// ================== Measurement ==================
+
+struct Result {
+string variant;
+string topology;
+int batch;
+double samples_per_sec;
+double forward_ns;   // per sample
+double backward_ns;  // per sample, a training step minus its forward pass
+long peak_rss_kb;
+};
+
+string topology_name(const vector<int>& sizes){
+    string res;
+    for(size_t i = 0; i < sizes.size(); i++) res += (i ? "-" : "") + to_string(sizes[i]);
+    return res;
+}
+
+long peak_rss_kb(){
+    ifstream status("/proc/self/status");
+    string line;
+    while(getline(status, line)){
+        if(line.compare(0, 6, "VmHWM:") == 0) return atol(line.c_str() + 6);
+    }
+    return 0;
+}
+
+// Whole passes until MIN_MS has gone by, nanoseconds per sample of the fastest repeat
+template<typename F>
+double time_per_sample(F pass, int n){
+    double best = 0;
+    for(int r = 0; r < REPEATS; r++){
+        auto start = chrono::high_resolution_clock::now();
+        double elapsed = 0;
+        int passes = 0;
+        do{
+            pass();
+            passes++;
+            elapsed = chrono::duration<double, nano>(chrono::high_resolution_clock::now() - start).count();
+        }while(elapsed < MIN_MS * 1e6);
+        double ns = elapsed / ((double)passes * n);
+        if(r == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+string to_json(const Result& r){
+    ostringstream s;
+    s << fixed << setprecision(1);
+    s << "{\"variant\": \"" << r.variant << "\", \"topology\": \"" << r.topology << "\", \"batch\": " << r.batch
+      << ", \"samples_per_sec\": " << r.samples_per_sec << ", \"forward_ns\": " << r.forward_ns
+      << ", \"backward_ns\": " << r.backward_ns << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}";
+    return s.str();
+}
+
+// Runs in the child, the result goes back through fd as one JSON line
+void run_cell(Variant& v, const vector<int>& sizes, int batch, int fd){
+    srand(SEED);
+    int in = sizes.front(), out = sizes.back();
+    vector<double> inputs, targets;
+    getSphereData(SAMPLES, in, out, inputs, targets);
+    if(!v.setup(sizes, batch, inputs.data(), targets.data(), SAMPLES)) _exit(2);
+
+    volatile double sink = 0;
+    double lr = LR;
+    v.train_epoch(lr); // warm up, first touch of every buffer
+    sink = sink + v.forward_all();
+    double forward_ns = time_per_sample([&]{ sink = sink + v.forward_all(); }, SAMPLES);
+    double train_ns = time_per_sample([&]{ v.train_epoch(lr); }, SAMPLES);
+
+    Result r = {v.name, topology_name(sizes), batch, 1e9 / train_ns, forward_ns, max(0.0, train_ns - forward_ns), peak_rss_kb()};
+    string line = to_json(r) + "\n";
+    if(write(fd, line.data(), line.size()) != (ssize_t)line.size()) _exit(1);
+    _exit(0);
+}
+
+// Forks for the cell, false when the variant cannot run it
+bool measure(Variant& v, const vector<int>& sizes, int batch, string& json){
+    int fds[2];
+    if(pipe(fds) != 0) return false;
+    cout.flush();
+    pid_t pid = fork();
+    if(pid == 0){
+        close(fds[0]);
+        run_cell(v, sizes, batch, fds[1]);
+    }
+    close(fds[1]);
+    json.clear();
+    char buf[512];
+    ssize_t got;
+    while((got = read(fds[0], buf, sizeof(buf))) > 0) json.append(buf, got);
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status) == 1){
+        cerr << v.name << " " << topology_name(sizes) << " batch " << batch << " failed" << endl;
+        return false;
+    }
+    while(!json.empty() && json.back() == '\n') json.pop_back();
+    return WEXITSTATUS(status) == 0 && !json.empty();
+}
+
+// ================== JSON ==================
+
+// Only reads files this program wrote, one result object per line
+string json_field(const string& line, const string& key){
+    size_t p = line.find("\"" + key + "\": ");
+    if(p == string::npos) return "";
+    p += key.size() + 4;
+    if(line[p] == '"'){
+        size_t e = line.find('"', p + 1);
+        return line.substr(p + 1, e - p - 1);
+    }
+    size_t e = line.find_first_of(",}", p);
+    return line.substr(p, e - p);
+}
+
+string result_key(const string& line){
+    return json_field(line, "variant") + " " + json_field(line, "topology") + " batch " + json_field(line, "batch");
+}
+
+map<string, double> read_baseline(const string& path){
+    map<string, double> res;
+    ifstream file(path);
+    string line;
+    while(getline(file, line)){
+        if(line.find("\"variant\"") == string::npos) continue;
+        res[result_key(line)] = atof(json_field(line, "samples_per_sec").c_str());
+    }
+    return res;
+}
+
+// ================== Benchmark ==================
+
+int main(int argc, char** argv){
+    bool quick = false;
+    string out_path = "suite.json";
+    string baseline_path = BASELINE;
+    double threshold = THRESHOLD;
+    for(int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if(arg == "--quick") quick = true;
+        else if(arg == "--out" && i + 1 < argc) out_path = argv[++i];
+        else if(arg == "--baseline" && i + 1 < argc) baseline_path = argv[++i];
+        else if(arg == "--threshold" && i + 1 < argc) threshold = atof(argv[++i]);
+        else{
+            cerr << "usage: " << argv[0] << " [--quick] [--out file] [--baseline file] [--threshold fraction]" << endl;
+            return 2;
+        }
+    }
+
+    vector<Variant*> variants = {&fnn_variant, &arr_variant, &vec_variant, &matrix_variant, &class_variant};
+    vector<vector<int>> topologies = {{2, 10, 10, 2}, {2, 20, 20, 20, 2}, {2, 64, 64, 2}, {3, 300, 300, 300, 2}};
+    vector<int> batches = {1, 16, 64};
+    if(quick) topologies.resize(2);
+
+    map<string, double> baseline = read_baseline(baseline_path);
+    bool regressed = false;
+    vector<string> results;
+
+    cout << fixed << setprecision(1);
+    cout << setw(24) << "variant" << setw(18) << "topology" << setw(7) << "batch" << setw(12) << "samples/s"
+         << setw(12) << "fwd ns" << setw(12) << "bwd ns" << setw(12) << "peak KB" << setw(12) << "baseline" << endl;
+    for(vector<int>& sizes : topologies){
+        for(Variant* v : variants){
+            for(int batch : batches){
+                string json;
+                if(!measure(*v, sizes, batch, json)) continue;
+                results.push_back(json);
+
+                double rate = atof(json_field(json, "samples_per_sec").c_str());
+                cout << setw(24) << v->name << setw(18) << topology_name(sizes) << setw(7) << batch << setw(12) << rate
+                     << setw(12) << json_field(json, "forward_ns") << setw(12) << json_field(json, "backward_ns")
+                     << setw(12) << json_field(json, "peak_rss_kb");
+                auto it = baseline.find(result_key(json));
+                if(it != baseline.end() && it->second > 0){
+                    double change = rate / it->second - 1;
+                    cout << setw(11) << showpos << 100 * change << "%" << noshowpos;
+                    if(change < -threshold){
+                        cout << "  REGRESSION";
+                        regressed = true;
+                    }
+                }
+                cout << endl;
+            }
+        }
+    }
+
+    ofstream out(out_path);
+    out << "{\n\"samples\": " << SAMPLES << ",\n\"results\": [\n";
+    for(size_t i = 0; i < results.size(); i++){
+        out << results[i] << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]\n}\n";
+    cout << "wrote " << out_path;
+    if(!baseline.empty()) cout << ", compared against " << baseline_path << " with a " << 100 * threshold << "% threshold";
+    cout << endl;
+
+    return regressed ? 1 : 0;
+}
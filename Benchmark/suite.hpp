@@ -0,0 +1,28 @@
+#ifndef SUITE_HPP
+#define SUITE_HPP
+
+#include <vector>
+
+using namespace std;
+
+// One network implementation as the suite drives it
+// Every cell of the grid runs in a process of its own, so setup can rely on fresh globals
+
+struct Variant {
+const char* name;
+// Builds the network and converts the samples into the variant's own types, false when it cannot run this cell
+// inputs are n x sizes[0] and targets n x sizes.back(), both without the bias
+bool (*setup)(const vector<int>& sizes, int batch, const double* inputs, const double* targets, int n);
+// Forward pass over every sample, the sum of the outputs keeps the work from being optimized away
+double (*forward_all)();
+// One epoch, every variant's backward pass runs its own forward pass first
+void (*train_epoch)(double lr);
+};
+
+extern Variant fnn_variant;
+extern Variant arr_variant;
+extern Variant vec_variant;
+extern Variant matrix_variant;
+extern Variant class_variant;
+
+#endif
@@ -0,0 +1,48 @@
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <iomanip>
+#include "../FastNN/cost_model.hpp"
+#include "suite.hpp"
+
+// The variant keeps its network in globals and has a main of its own, both go into a namespace
+#define main arr_main
+namespace arr {
+using std::to_string;
+#include "../Implementations/without_abstraction_arr/without_abstraction_arr.cpp"
+}
+#undef main
+
+// ================== Variant ==================
+
+static vector<double*> arr_inputs;
+static vector<double*> arr_targets;
+
+// The topology lives in a fixed global array, deeper nets do not fit
+static bool arr_setup(const vector<int>& sizes, int batch, const double* inputs, const double* targets, int n){
+    if(batch != 1 || sizes.size() > sizeof(arr::layer_sz) / sizeof(int)) return false;
+    int in = sizes.front(), out = sizes.back();
+    arr::layer_n = sizes.size() - 1;
+    for(size_t i = 0; i < sizes.size(); i++) arr::layer_sz[i] = sizes[i];
+    arr::init_network();
+
+    for(int i = 0; i < n; i++){
+        arr_inputs.push_back((double*)inputs + (size_t)i * in);
+        arr_targets.push_back((double*)targets + (size_t)i * out);
+    }
+    return true;
+}
+
+static double arr_forward_all(){
+    double sum = 0;
+    for(size_t i = 0; i < arr_inputs.size(); i++) sum += arr::forward(arr_inputs[i])[0];
+    return sum;
+}
+
+static void arr_train_epoch(double lr){
+    for(size_t i = 0; i < arr_inputs.size(); i++) arr::backward(arr_inputs[i], arr_targets[i], lr);
+}
+
+Variant arr_variant = {"without_abstraction_arr", arr_setup, arr_forward_all, arr_train_epoch};
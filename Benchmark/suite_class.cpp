@@ -0,0 +1,54 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <memory>
+#include "../FastNN/cost_model.hpp"
+#include "suite.hpp"
+
+// Its classes share names with the matrix variant and it has a main of its own, both go into a namespace
+#define main class_main
+namespace with_class {
+using std::to_string;
+#include "../Implementations/with_class/with_classes.cpp"
+}
+#undef main
+
+// ================== Variant ==================
+
+static unique_ptr<with_class::NeuralNetwork> class_nn;
+static vector<vector<double>> class_inputs;
+static vector<vector<double>> class_targets;
+
+// This variant takes the bias as a constant first input, so it is one wider than the others
+static bool class_setup(const vector<int>& sizes, int batch, const double* inputs, const double* targets, int n){
+    if(batch != 1) return false;
+    int in = sizes.front(), out = sizes.back();
+    vector<int> with_bias = sizes;
+    with_bias[0]++;
+    class_nn.reset(new with_class::NeuralNetwork(with_bias, make_unique<with_class::Sigmoid>(), 0));
+
+    for(int i = 0; i < n; i++){
+        vector<double> x(1, 1.0);
+        x.insert(x.end(), inputs + (size_t)i * in, inputs + (size_t)(i+1) * in);
+        class_inputs.push_back(x);
+        class_targets.push_back(vector<double>(targets + (size_t)i * out, targets + (size_t)(i+1) * out));
+    }
+    return true;
+}
+
+static double class_forward_all(){
+    double sum = 0;
+    for(size_t i = 0; i < class_inputs.size(); i++) sum += class_nn->forward(class_inputs[i])[0];
+    return sum;
+}
+
+// NeuralNetwork::train prints every epoch, so the samples are fed to backward directly
+static void class_train_epoch(double lr){
+    class_nn->lr = lr;
+    for(size_t i = 0; i < class_inputs.size(); i++) class_nn->backward(class_inputs[i], class_targets[i]);
+}
+
+Variant class_variant = {"with_class", class_setup, class_forward_all, class_train_epoch};
@@ -0,0 +1,53 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <memory>
+#include "../Implementations/matrix/matrix.hpp"
+#include "suite.hpp"
+
+// Its classes share names with the class variant and it has a main of its own, both go into a namespace
+// Matrix itself is compiled from matrix.cpp as usual
+#define main matrix_main
+namespace matrix_nn {
+#include "../Implementations/matrix/matrix_nn.cpp"
+}
+#undef main
+
+// ================== Variant ==================
+
+static unique_ptr<matrix_nn::NeuralNetwork> matrix_net;
+static Matrix matrix_inputs;   // one sample per row
+static Matrix matrix_targets;
+static int matrix_batch;
+
+// The learning rate is fixed inside NeuralNetwork, single samples are passed as views of the rows
+static bool matrix_setup(const vector<int>& sizes, int batch, const double* inputs, const double* targets, int n){
+    int in = sizes.front(), out = sizes.back();
+    matrix_net.reset(new matrix_nn::NeuralNetwork(sizes));
+    matrix_batch = batch;
+
+    matrix_inputs = Matrix(n, in, MATRIX_UNINIT);
+    matrix_targets = Matrix(n, out, MATRIX_UNINIT);
+    for(int i = 0; i < n; i++){
+        for(int k = 0; k < in; k++) matrix_inputs(i, k) = inputs[(size_t)i * in + k];
+        for(int k = 0; k < out; k++) matrix_targets(i, k) = targets[(size_t)i * out + k];
+    }
+    if(batch > 1) matrix_net->reserve_batch(batch);
+    return true;
+}
+
+static double matrix_forward_all(){
+    double sum = 0;
+    for(int i = 0; i < matrix_inputs.rows(); i++) sum += (*matrix_net->forward(matrix_inputs.row(i).t()))(0);
+    return sum;
+}
+
+static void matrix_train_epoch(double lr){
+    if(matrix_batch > 1){
+        matrix_net->train_batch(matrix_inputs, matrix_targets, matrix_batch, 1);
+        return;
+    }
+    for(int i = 0; i < matrix_inputs.rows(); i++) matrix_net->backward(matrix_inputs.row(i).t(), matrix_targets.row(i).t());
+}
+
+Variant matrix_variant = {"matrix", matrix_setup, matrix_forward_all, matrix_train_epoch};
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include "../FastNN/cost_model.hpp"
+#include "suite.hpp"
+
+// The variant keeps its network in globals and has a main of its own, both go into a namespace
+#define main vec_main
+namespace vec {
+using std::to_string;
+#include "../Implementations/without_abstraction_vec/without_abstraction_vec.cpp"
+}
+#undef main
+
+// ================== Variant ==================
+
+static vector<vector<double>> vec_inputs;
+static vector<vector<double>> vec_targets;
+
+static bool vec_setup(const vector<int>& sizes, int batch, const double* inputs, const double* targets, int n){
+    if(batch != 1) return false;
+    int in = sizes.front(), out = sizes.back();
+    vec::sizes = sizes;
+    vec::layer_n = sizes.size() - 1;
+    vec::weights.assign(vec::layer_n, {});
+    vec::beforeActivation.assign(vec::layer_n, {});
+    vec::afterActivation.assign(vec::layer_n, {});
+    vec::delta.assign(vec::layer_n, {});
+    vec::init_network();
+
+    for(int i = 0; i < n; i++){
+        vec_inputs.push_back(vector<double>(inputs + (size_t)i * in, inputs + (size_t)(i+1) * in));
+        vec_targets.push_back(vector<double>(targets + (size_t)i * out, targets + (size_t)(i+1) * out));
+    }
+    return true;
+}
+
+static double vec_forward_all(){
+    double sum = 0;
+    for(size_t i = 0; i < vec_inputs.size(); i++) sum += vec::forward(vec_inputs[i])[0];
+    return sum;
+}
+
+static void vec_train_epoch(double lr){
+    for(size_t i = 0; i < vec_inputs.size(); i++) vec::backward(vec_inputs[i], vec_targets[i], lr);
+}
+
+Variant vec_variant = {"without_abstraction_vec", vec_setup, vec_forward_all, vec_train_epoch};
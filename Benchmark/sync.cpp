@@ -0,0 +1,100 @@
+#include <iostream>
+#include <stdexcept>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <cstring>
+
+#include "../FastNN/FNN.hpp"
+#include "common.hpp"
+
+using namespace std;
+
+// Samples/sec of train_sync from 1 thread up to every core, every count is run twice
+// and the weights compared bit for bit. The max thread count can be passed as the first argument
+
+// ================== Global Variables ==================
+
+#define EPOCHS 200
+#define BATCH_SIZE 16
+
+// ================== Benchmark ==================
+
+double base = 0;
+int failed = 0;
+
+void run(int threads, Data_Entry<double>* training_data, int training_n, Data_Entry<double>* testing_data, int testing_n){
+    int layer_n = 3;
+    int layer_sz[2][4] = {{2, 20, 20, 2}, {2, 20, 20, 2}};
+    FNN<double>* nn[2];
+    double rate = 0;
+    for(int r = 0; r < 2; r++){
+        srand(SEED);
+        double lr = 1;
+        nn[r] = new FNN<double>(layer_n, layer_sz[r], _sigmoid, lr);
+
+        auto startTime = chrono::high_resolution_clock::now();
+        nn[r]->train_sync(training_data, training_n, BATCH_SIZE, EPOCHS, lr, threads);
+        auto endTime = chrono::high_resolution_clock::now();
+        rate = (double)EPOCHS * training_n / chrono::duration<double>(endTime - startTime).count();
+    }
+    if(threads == 1) base = rate;
+
+    bool identical = true;
+    for(int i = 0; i < layer_n; i++){
+        size_t sz = (size_t)layer_sz[0][i+1] * layer_sz[0][i] * sizeof(double);
+        identical = identical && memcmp(nn[0]->weights_flat[i], nn[1]->weights_flat[i], sz) == 0;
+    }
+    if(!identical) failed = 1;
+
+    double loss = 0;
+    for(int i = 0; i < testing_n; i++){
+        loss += nn[0]->loss(nn[0]->forward(testing_data[i].first), testing_data[i].second);
+    }
+
+    cout << setw(10) << threads << fixed
+         << setw(14) << setprecision(0) << rate
+         << setw(10) << setprecision(2) << rate / base
+         << setw(12) << setprecision(6) << loss / testing_n
+         << setw(12) << (identical ? "yes" : "NO") << endl;
+
+    delete nn[0];
+    delete nn[1];
+}
+
+int main(int argc, char** argv){
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int)thread::hardware_concurrency();
+    if(max_threads < 1) max_threads = 1;
+
+    srand(SEED);
+    int training_n = 4000;
+    Data_Entry<double>* training_data = getCircleData<double>(training_n, 10, 10, 3, 4, 2);
+    int testing_n = 1000;
+    Data_Entry<double>* testing_data = getCircleData<double>(testing_n, 10, 10, 3, 4, 2);
+
+    cout << setw(10) << "threads" << setw(14) << "samples/s" << setw(10) << "speedup" << setw(12) << "loss" << setw(12) << "identical" << endl;
+
+    int threads = 1;
+    for(; threads <= max_threads; threads *= 2){
+        run(threads, training_data, training_n, testing_data, testing_n);
+    }
+    if(threads / 2 != max_threads){
+        run(max_threads, training_data, training_n, testing_data, testing_n);
+    }
+
+    // A batch size of 0 would step through the data forever
+    int layer_sz[] = {2, 20, 20, 2};
+    double lr = 1;
+    FNN<double> nn(3, layer_sz, _sigmoid, lr);
+    try{
+        nn.train_sync(training_data, training_n, 0, 1, lr, 1);
+        cout << "batch size 0 accepted" << endl;
+        failed = 1;
+    }catch(const invalid_argument& e){
+        cout << "batch size 0 refused: " << e.what() << endl;
+    }
+
+    return failed;
+}
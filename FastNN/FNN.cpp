@@ -1,9 +1,29 @@
 #include "FNN.hpp"
+#include "kernels.hpp"
+#include "memory.hpp"
+#include "thread_pool.hpp"
+#include "checkpoint.hpp"
+#include "dataset.hpp"
+#include "dataset_file.hpp"
+#include "prefetch.hpp"
 #include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // ================== Utils ==================
 
-string to_string(Vec v, int n){
+template<typename T>
+string to_string(Vec<T> v, int n){
     string res = "[";
     for(int i = 0; i < n; i++){
         res += to_string(v[i]);
@@ -15,10 +35,11 @@ string to_string(Vec v, int n){
     return res;
 }
 
-string to_string(Mat ma, int n, int m){
+template<typename T>
+string to_string(Mat<T> ma, int n, int m){
     string res = "[";
     for(int i = 0; i < n; i++){
-        res += to_string((Vec)ma[i],m);
+        res += to_string(ma[i], m);
         if(i < n - 1){
             res += ",\n";
         }
@@ -27,7 +48,8 @@ string to_string(Mat ma, int n, int m){
     return res;
 }
 
-string to_string(Net n, int* sizes, int am){
+template<typename T>
+string to_string(Net<T> n, int* sizes, int am){
     string res = "[";
     for(int i = 0; i < am; i++){
         res += to_string(n[i], sizes[i+1], sizes[i]);
@@ -41,25 +63,44 @@ string to_string(Net n, int* sizes, int am){
 
 // ================== Activation Functions ==================
 
-double relu(double x){
-    return max(0.0, x);
+template<typename T>
+T relu(T x){
+    return max(T(0), x);
 }
 
-double relu_d(double x, double y){
+template<typename T>
+T relu_d(T x, T y){
     return x > 0 ? 1 : 0;
 }
 
-double sigmoid(double x){
+template<typename T>
+T sigmoid(T x){
     return 1 / (1 + exp(-x));
 }
 
-double sigmoid_d(double x, double y){
+template<typename T>
+T sigmoid_d(T x, T y){
     return y * (1 - y);
 }
 
+// ================== Memory ==================
+
+// Rounds a block up to a whole number of cache lines
+template<typename T>
+static size_t arena_pad(size_t n){
+    const size_t line = ARENA_ALIGN / sizeof(T);
+    return (n + line - 1) / line * line;
+}
+
+template<typename T>
+static T* arena_alloc(size_t n){
+    return aligned_new<T>(n, ARENA_ALIGN);
+}
+
 // ================== Neural Network Class ==================
 
-FNN::FNN(int layer_n, int* layer_sz, int activation, double lr){
+template<typename T>
+FNN<T>::FNN(int layer_n, int* layer_sz, int activation, double lr){
     this->layer_n = layer_n;
     this->layer_sz = layer_sz;
     this->act_type = activation;
@@ -68,44 +109,171 @@ FNN::FNN(int layer_n, int* layer_sz, int activation, double lr){
     init();
 }
 
-void FNN::init(){
-    weights = new Mat[layer_n];
+template<typename T>
+FNN<T>::FNN(int layer_n, int* layer_sz, int activation, double lr, T* weight_blocks){
+    this->layer_n = layer_n;
+    this->layer_sz = layer_sz;
+    this->act_type = activation;
+    this->lr = lr;
+
+    init(weight_blocks);
+}
+
+template<typename T>
+FNN<T>::FNN(FNN&& other){
+    layer_n = other.layer_n;
+    layer_sz = other.layer_sz;
+    act_type = other.act_type;
+    lr = other.lr;
+    epoch = other.epoch;
+    checkpointer = other.checkpointer;
+    act_layer = other.act_layer;
+    act_d_layer = other.act_d_layer;
+    arena = other.arena;
+    arena_sz = other.arena_sz;
+    weights = other.weights;
+    weights_flat = other.weights_flat;
+    biasInput = other.biasInput;
+    beforeActivation = other.beforeActivation;
+    afterActivation = other.afterActivation;
+    delta = other.delta;
+    batch_arena = other.batch_arena;
+    batch_cap = other.batch_cap;
+    batchInput = other.batchInput;
+    batchBefore = other.batchBefore;
+    batchAfter = other.batchAfter;
+    batchDelta = other.batchDelta;
+    mapping = other.mapping;
+    mapping_sz = other.mapping_sz;
+    owned_sz = other.owned_sz;
+    layer_stats = other.layer_stats;
+
+    other.arena = nullptr;
+    other.weights = nullptr;
+    other.weights_flat = nullptr;
+    other.beforeActivation = nullptr;
+    other.afterActivation = nullptr;
+    other.delta = nullptr;
+    other.batch_arena = nullptr;
+    other.batchBefore = nullptr;
+    other.batchAfter = nullptr;
+    other.batchDelta = nullptr;
+    other.mapping = nullptr;
+    other.owned_sz = nullptr;
+    other.checkpointer = nullptr;
+    other.layer_stats = nullptr;
+    if(checkpointer != nullptr) checkpointer->nn = this;
+}
+
+template<typename T>
+FNN<T>::~FNN(){
+    if(checkpointer != nullptr) checkpointer->nn = nullptr;
+    if(weights != nullptr){
+        for(int i = 0; i < layer_n; i++) delete[] weights[i];
+    }
+    delete[] weights;
+    delete[] weights_flat;
+    delete[] beforeActivation;
+    delete[] afterActivation;
+    delete[] delta;
+    delete[] batchBefore;
+    delete[] batchAfter;
+    delete[] batchDelta;
+    aligned_delete(arena);
+    aligned_delete(batch_arena);
+    if(mapping != nullptr) munmap(mapping, mapping_sz);
+    delete[] owned_sz;
+    delete[] layer_stats;
+}
+
+template<typename T>
+void FNN<T>::init(T* weight_blocks){
+    const ActKernels<T>& kernels = act_kernels<T>();
+    act_layer = act_type == _relu ? kernels.relu : kernels.sigmoid;
+    act_d_layer = act_type == _relu ? kernels.relu_d : kernels.sigmoid_d;
+
+    weights = new Mat<T>[layer_n];
+    weights_flat = new Vec<T>[layer_n];
 
-    beforeActivation = new Vec[layer_n];
-    afterActivation = new Vec[layer_n];
-    delta = new Vec[layer_n];
+    beforeActivation = new Vec<T>[layer_n];
+    afterActivation = new Vec<T>[layer_n];
+    delta = new Vec<T>[layer_n];
+
+    batch_arena = nullptr;
+    batch_cap = 0;
+    batchInput = nullptr;
+    batchBefore = new Vec<T>[layer_n];
+    batchAfter = new Vec<T>[layer_n];
+    batchDelta = new Vec<T>[layer_n];
+
+    mapping = nullptr;
+    mapping_sz = 0;
+    owned_sz = nullptr;
+    epoch = 0;
+    checkpointer = nullptr;
+#ifdef FNN_PROFILE
+    layer_stats = new LayerStats[layer_n]();
+#else
+    layer_stats = nullptr;
+#endif
 
     layer_sz[0]++; // For bias
+
+    // Every block starts on its own cache line
+    arena_sz = arena_pad<T>(layer_sz[0]);
+    for(int i = 0; i < layer_n; i++){
+        if(weight_blocks == nullptr) arena_sz += arena_pad<T>((size_t)layer_sz[i+1] * layer_sz[i]);
+        arena_sz += 3 * arena_pad<T>(layer_sz[i+1]);
+    }
+    arena = arena_alloc<T>(arena_sz);
+
+    T* p = arena;
+    biasInput = p;
+    biasInput[layer_sz[0]-1] = 1;
+    p += arena_pad<T>(layer_sz[0]);
     for(int i = 0; i < layer_n; i++){
         // Weights
-        weights[i] = new Vec[layer_sz[i+1]];
+        if(weight_blocks == nullptr){
+            weights_flat[i] = p;
+            p += arena_pad<T>((size_t)layer_sz[i+1] * layer_sz[i]);
+        }else{
+            weights_flat[i] = weight_blocks;
+            weight_blocks += arena_pad<T>((size_t)layer_sz[i+1] * layer_sz[i]);
+        }
+        weights[i] = new Vec<T>[layer_sz[i+1]];
         for(int j = 0; j < layer_sz[i+1]; j++){
-            weights[i][j] = new double[layer_sz[i]];
+            weights[i][j] = weights_flat[i] + (size_t)j * layer_sz[i];
+            if(weight_blocks != nullptr) continue;
             for(int k = 0; k < layer_sz[i]; k++){
                 weights[i][j][k] = (rand() % 100) / 100.0;
             }
         }
 
         // Before Activation
-        beforeActivation[i] = new double[layer_sz[i+1]];
+        beforeActivation[i] = p;
+        p += arena_pad<T>(layer_sz[i+1]);
 
         // After Activation
-        afterActivation[i] = new double[layer_sz[i+1]];
+        afterActivation[i] = p;
+        p += arena_pad<T>(layer_sz[i+1]);
 
         // Delta
-        delta[i] = new double[layer_sz[i+1]];
+        delta[i] = p;
+        p += arena_pad<T>(layer_sz[i+1]);
     }
 }
 
 
 
-double FNN::activation(double x){
+template<typename T>
+T FNN<T>::activation(T x){
     if(act_type == _relu) return relu(x);
     if(act_type == _sigmoid) return sigmoid(x);
     return 0;
 }
 
-double FNN::activation_d(double x, double y){
+template<typename T>
+T FNN<T>::activation_d(T x, T y){
     if(act_type == _relu) return relu_d(x, y);
     if(act_type == _sigmoid) return sigmoid_d(x, y);
     return 0;
@@ -113,78 +281,849 @@ double FNN::activation_d(double x, double y){
 
 
 
-Vec FNN::add_bias(Vec v){
-    Vec res = new double[layer_sz[0]];
+// Copies v into biasInput, whose last element is always the bias
+template<typename T>
+Vec<T> FNN<T>::add_bias(Vec<T> v){
     for(int i = 0; i < layer_sz[0]-1; i++){
-        res[i] = v[i];
+        biasInput[i] = v[i];
     }
-    res[layer_sz[0]-1] = 1;
-    return res;
+    return biasInput;
+}
+
+template<typename T>
+Vec<T> FNN<T>::forward(Vec<T> input) {
+    Scratch<T> s = own_scratch();
+    return forward(input, s);
+}
+
+template<typename T>
+void FNN<T>::backward(Vec<T> input, Vec<T> result, double lr) {
+    Scratch<T> s = own_scratch();
+    backward(input, result, lr, s);
 }
 
-Vec FNN::forward(Vec input) {
-    input = add_bias(input);
+template<typename T>
+Vec<T> FNN<T>::forward(Vec<T> input, Scratch<T>& s) {
+    for(int i = 0; i < layer_sz[0]-1; i++){
+        s.input[i] = input[i];
+    }
+    input = s.input;
     for(int i = 0; i < layer_n; i++){
-        for(int j = 0; j < layer_sz[i+1]; j++){
-            double sum = 0;
-            for(int k = 0; k < layer_sz[i]; k++){
-                sum += weights[i][j][k] * input[k];
+        int in = layer_sz[i], out = layer_sz[i+1];
+        PROF_START(t0);
+        for(int j = 0; j < out; j++){
+            Vec<T> w = weights_flat[i] + (size_t)j * in;
+            T sum = 0;
+            for(int k = 0; k < in; k++){
+                sum += w[k] * input[k];
             }
-            beforeActivation[i][j] = sum;
-            afterActivation[i][j] = activation(sum);
+            s.before[i][j] = sum;
         }
-        input = afterActivation[i];
+        PROF_STOP(t0, s.arena ? nullptr : layer_stats, i, PROF_FORWARD, 2.0 * out * in, ((double)out * in + in + out) * sizeof(T));
+        PROF_START(t1);
+        act_layer(s.before[i], s.after[i], out);
+        PROF_STOP(t1, s.arena ? nullptr : layer_stats, i, PROF_ACTIVATION, out, 2.0 * out * sizeof(T));
+        input = s.after[i];
     }
     return input;
 }
 
-void FNN::backward(Vec input, Vec result, double lr) {
-    Vec output = forward(input);
-    input = add_bias(input);
+template<typename T>
+void FNN<T>::backward(Vec<T> input, Vec<T> result, double lr, Scratch<T>& s) {
+    forward(input, s);
+    backward_cached(result, lr, s);
+}
+
+template<typename T>
+void FNN<T>::backward_cached(Vec<T> result, double lr) {
+    Scratch<T> s = own_scratch();
+    backward_cached(result, lr, s);
+}
+
+// Backward on the activations the last forward(input, s) left in s, without running it again
+// Walks the layers from the output down and streams every weight row once: the row's share of the
+// previous layer's delta is read before the row is updated, so both use the old weights like in deltas()
+template<typename T>
+void FNN<T>::backward_cached(Vec<T> result, double lr, Scratch<T>& s) {
+    int last = layer_sz[layer_n];
+    PROF_START(t_out);
+    for(int i = 0; i < last; i++){
+        s.delta[layer_n-1][i] = result[i] - s.after[layer_n-1][i];
+    }
+    act_d_layer(s.before[layer_n-1], s.after[layer_n-1], s.delta[layer_n-1], last);
+    PROF_STOP(t_out, s.arena ? nullptr : layer_stats, layer_n-1, PROF_DELTA, 2.0 * last, 4.0 * last * sizeof(T));
+
+    for(int i = layer_n-1; i >= 0; i--){
+        int in = layer_sz[i], out = layer_sz[i+1];
+        Vec<T> prev = i == 0 ? s.input : s.after[i-1];
+        Vec<T> below = i == 0 ? nullptr : s.delta[i-1];
+        PROF_START(t0);
+        if(below != nullptr){
+            fill(below, below + in, T(0));
+            for(int j = 0; j < out; j++){
+                Vec<T> w = weights_flat[i] + (size_t)j * in;
+                T g = s.delta[i][j];
+                T d = (T)lr * g;
+                for(int k = 0; k < in; k++){
+                    below[k] += g * w[k];
+                    w[k] += d * prev[k];
+                }
+            }
+        }else{
+            for(int j = 0; j < out; j++){
+                Vec<T> w = weights_flat[i] + (size_t)j * in;
+                T d = (T)lr * s.delta[i][j];
+                for(int k = 0; k < in; k++){
+                    w[k] += d * prev[k];
+                }
+            }
+        }
+        PROF_STOP(t0, s.arena ? nullptr : layer_stats, i, PROF_UPDATE, (below ? 4.0 : 2.0) * out * in, (2.0 * out * in + 2.0 * in + out) * sizeof(T));
+        if(below == nullptr) continue;
+        PROF_START(t1);
+        act_d_layer(s.before[i-1], s.after[i-1], below, in);
+        PROF_STOP(t1, s.arena ? nullptr : layer_stats, i-1, PROF_DELTA, in, 3.0 * in * sizeof(T));
+    }
+}
+
+// Forward pass and every layer's delta, the weights are left untouched
+template<typename T>
+void FNN<T>::deltas(Vec<T> input, Vec<T> result, Scratch<T>& s) {
+    Vec<T> output = forward(input, s);
 
     // Update deltas
-    for(int i = 0; i < layer_sz[layer_n]; i++){
-        delta[layer_n-1][i] = activation_d(beforeActivation[layer_n-1][i], afterActivation[layer_n-1][i]) * (result[i] - output[i]);
+    int last = layer_sz[layer_n];
+    PROF_START(t_out);
+    for(int i = 0; i < last; i++){
+        s.delta[layer_n-1][i] = result[i] - output[i];
     }
+    act_d_layer(s.before[layer_n-1], s.after[layer_n-1], s.delta[layer_n-1], last);
+    PROF_STOP(t_out, s.arena ? nullptr : layer_stats, layer_n-1, PROF_DELTA, 2.0 * last, 4.0 * last * sizeof(T));
     for(int i = layer_n-2; i >= 0; i--){
-        for(int j = 0; j < layer_sz[i+1]; j++){
-            double sum = 0;
-            for(int k = 0; k < layer_sz[i+2]; k++){
-                sum += delta[i+1][k] * weights[i+1][k][j];
+        int out = layer_sz[i+1], next = layer_sz[i+2];
+        // delta^T * W as a one-row product, which walks W row by row instead of down its columns
+        // It streams weights_flat[i+1], so it is charged to layer i+1, see profile.hpp
+        PROF_START(t0);
+        gemm(false, false, 1, out, next, 1, s.delta[i+1], next, weights_flat[i+1], out, 0, s.delta[i], out);
+        PROF_STOP(t0, s.arena ? nullptr : layer_stats, i+1, PROF_DELTA, 2.0 * next * out, ((double)next * out + next + out) * sizeof(T));
+        PROF_START(t1);
+        act_d_layer(s.before[i], s.after[i], s.delta[i], out);
+        PROF_STOP(t1, s.arena ? nullptr : layer_stats, i, PROF_DELTA, out, 3.0 * out * sizeof(T));
+    }
+}
+
+// Every training loop reads as many inputs and targets per row as the network has, a narrower source would be read past its end
+// and a wider one would feed the network misaligned rows
+static void check_widths(const char* source, int in, int out, int net_in, int net_out){
+    if(in == net_in && out == net_out) return;
+    throw invalid_argument(string(source) + " has " + to_string(in) + " inputs and " + to_string(out) + " outputs, the network takes "
+        + to_string(net_in) + " and " + to_string(net_out));
+}
+
+// The batch loops step by batch_size, at 0 or below they would never end
+static void check_batch_size(int batch_size){
+    if(batch_size > 0) return;
+    throw invalid_argument("batch_size has to be positive, got " + to_string(batch_size));
+}
+
+template<typename T>
+void FNN<T>::train(Data_Entry<T>* dataset, int n, int epochs, double& lr){
+    for(int e = 0; e < epochs; e++){
+        for(int i = 0; i < n; i++){
+            backward(dataset[i].first, dataset[i].second, lr);
+        }
+        end_epoch(lr);
+    }
+}
+
+template<typename T>
+void FNN<T>::train(Dataset<T>& data, int epochs, double& lr, bool shuffle){
+    check_widths("Dataset", data.in, data.out, layer_sz[0]-1, layer_sz[layer_n]);
+    for(int e = 0; e < epochs; e++){
+        if(shuffle) data.shuffle();
+        for(int i = 0; i < data.n; i++){
+            backward(data.input_at(i), data.target_at(i), lr);
+        }
+        end_epoch(lr);
+    }
+}
+
+template<typename T>
+void FNN<T>::train(DatasetStream<T>& data, int epochs, double& lr){
+    check_widths("DatasetStream", data.in, data.out, layer_sz[0]-1, layer_sz[layer_n]);
+    const T* x;
+    const T* y;
+    for(int e = 0; e < epochs; e++){
+        data.rewind();
+        while(data.next(x, y)){
+            backward((Vec<T>)x, (Vec<T>)y, lr);
+        }
+        end_epoch(lr);
+    }
+}
+
+// Learning rate decay and bookkeeping shared by every training loop
+template<typename T>
+void FNN<T>::end_epoch(double& lr){
+    if(epoch % 50 == 0) lr *= 0.99;
+    epoch++;
+    this->lr = lr;
+    if(checkpointer != nullptr) checkpointer->maybe_checkpoint();
+}
+
+// ================== Parallel Training ==================
+
+template<typename T>
+Scratch<T> FNN<T>::own_scratch(){
+    return {nullptr, biasInput, beforeActivation, afterActivation, delta};
+}
+
+// Same layout as the layer buffers in the arena, each block on its own cache line
+template<typename T>
+Scratch<T> FNN<T>::make_scratch(){
+    size_t sz = arena_pad<T>(layer_sz[0]);
+    for(int i = 0; i < layer_n; i++){
+        sz += 3 * arena_pad<T>(layer_sz[i+1]);
+    }
+
+    Scratch<T> s;
+    s.arena = arena_alloc<T>(sz);
+    s.before = new Vec<T>[layer_n];
+    s.after = new Vec<T>[layer_n];
+    s.delta = new Vec<T>[layer_n];
+
+    T* p = s.arena;
+    s.input = p;
+    s.input[layer_sz[0]-1] = 1;
+    p += arena_pad<T>(layer_sz[0]);
+    for(int i = 0; i < layer_n; i++){
+        s.before[i] = p;
+        p += arena_pad<T>(layer_sz[i+1]);
+        s.after[i] = p;
+        p += arena_pad<T>(layer_sz[i+1]);
+        s.delta[i] = p;
+        p += arena_pad<T>(layer_sz[i+1]);
+    }
+    return s;
+}
+
+template<typename T>
+void FNN<T>::free_scratch(Scratch<T>& s){
+    if(s.arena == nullptr) return;
+    aligned_delete(s.arena);
+    delete[] s.before;
+    delete[] s.after;
+    delete[] s.delta;
+    s.arena = nullptr;
+}
+
+// Hogwild SGD, the weight writes race on purpose
+// With sparse enough overlap the lost updates cost less than any locking would
+// The weights are read and written as plain T, which is a data race and so undefined behaviour in the C++ memory model.
+// That is accepted by design: aligned float and double accesses are single instructions on the targets this builds for,
+// so a thread sees either the old or the new weight and never a torn one. ThreadSanitizer reports it
+template<typename T>
+void FNN<T>::train_parallel(Data_Entry<T>* dataset, int n, int epochs, double& lr, int threads){
+    if(threads <= 0) threads = thread_pool().size();
+    threads = min(threads, n);
+    if(threads <= 1){
+        train(dataset, n, epochs, lr);
+        return;
+    }
+
+    vector<Scratch<T>> scratch(threads);
+    scratch[0] = own_scratch();
+    for(int t = 1; t < threads; t++) scratch[t] = make_scratch();
+
+    // One parallel_for per epoch, so end_epoch and an attached checkpointer run at every epoch boundary
+    // with every shard finished, and see the weights of that epoch
+    for(int e = 0; e < epochs; e++){
+        parallel_for(threads, [&](int t){
+            int from = (long long)t * n / threads;
+            int to = (long long)(t+1) * n / threads;
+            for(int i = from; i < to; i++){
+                backward(dataset[i].first, dataset[i].second, lr, scratch[t]);
+            }
+        });
+        end_epoch(lr);
+    }
+
+    for(int t = 1; t < threads; t++) free_scratch(scratch[t]);
+}
+
+// Every batch is cut into the same slices whichever thread runs them, so the summation order never depends on timing
+template<typename T>
+void FNN<T>::train_sync(Data_Entry<T>* dataset, int n, int batch_size, int epochs, double& lr, int threads){
+    check_batch_size(batch_size);
+    if(threads <= 0) threads = thread_pool().size();
+    threads = max(1, min(threads, batch_size));
+
+    // One gradient buffer per slice, shaped like the weights, each layer on its own cache lines
+    vector<size_t> offset(layer_n + 1, 0);
+    for(int i = 0; i < layer_n; i++){
+        offset[i+1] = offset[i] + arena_pad<T>((size_t)layer_sz[i+1] * layer_sz[i]);
+    }
+    vector<T*> grad(threads);
+    vector<Scratch<T>> scratch(threads);
+    for(int t = 0; t < threads; t++){
+        grad[t] = arena_alloc<T>(offset[layer_n]);
+        scratch[t] = t == 0 ? own_scratch() : make_scratch();
+    }
+
+    for(int e = 0; e < epochs; e++){
+        for(int s = 0; s < n; s += batch_size){
+            int b = min(batch_size, n - s);
+
+            // Gradient of every slice
+            parallel_for(threads, [&](int t){
+                T* g = grad[t];
+                fill(g, g + offset[layer_n], T(0));
+                int from = s + (long long)t * b / threads;
+                int to = s + (long long)(t+1) * b / threads;
+                for(int r = from; r < to; r++){
+                    deltas(dataset[r].first, dataset[r].second, scratch[t]);
+                    for(int i = 0; i < layer_n; i++){
+                        Vec<T> prev = i == 0 ? scratch[t].input : scratch[t].after[i-1];
+                        for(int j = 0; j < layer_sz[i+1]; j++){
+                            T* gw = g + offset[i] + (size_t)j * layer_sz[i];
+                            T d = scratch[t].delta[i][j];
+                            for(int k = 0; k < layer_sz[i]; k++){
+                                gw[k] += d * prev[k];
+                            }
+                        }
+                    }
+                }
+            });
+
+            // Tree all-reduce, slice t folds in t + stride, the sum ends up in grad[0]
+            for(int stride = 1; stride < threads; stride *= 2){
+                parallel_for((threads + 2 * stride - 1) / (2 * stride), [&](int pair){
+                    int t = pair * 2 * stride;
+                    if(t + stride >= threads) return;
+                    T* __restrict dst = grad[t];
+                    const T* __restrict src = grad[t + stride];
+                    for(size_t k = 0; k < offset[layer_n]; k++){
+                        dst[k] += src[k];
+                    }
+                });
             }
-            delta[i][j] = activation_d(beforeActivation[i][j], afterActivation[i][j]) * sum;
+
+            // One update with the batch average, every slice takes the same share of rows of each layer
+            // Each weight is updated on its own, so the split does not change a single bit
+            T scale = T(lr / b);
+            parallel_for(threads, [&](int t){
+                for(int i = 0; i < layer_n; i++){
+                    size_t from = (size_t)((long long)t * layer_sz[i+1] / threads) * layer_sz[i];
+                    size_t to = (size_t)((long long)(t+1) * layer_sz[i+1] / threads) * layer_sz[i];
+                    Vec<T> w = weights_flat[i];
+                    const T* gw = grad[0] + offset[i];
+                    for(size_t k = from; k < to; k++){
+                        w[k] += scale * gw[k];
+                    }
+                }
+            });
         }
+        end_epoch(lr);
     }
 
-    // Update weights
+    for(int t = 0; t < threads; t++){
+        aligned_delete(grad[t]);
+        free_scratch(scratch[t]);
+    }
+}
+
+
+
+// ================== Mini-batch ==================
+
+template<typename T>
+void FNN<T>::reserve_batch(int batch_size){
+    check_batch_size(batch_size);
+    if(batch_size <= batch_cap) return;
+
+    size_t sz = arena_pad<T>((size_t)batch_size * layer_sz[0]);
     for(int i = 0; i < layer_n; i++){
-        for(int j = 0; j < layer_sz[i+1]; j++){
-            for(int k = 0; k < layer_sz[i]; k++){
-                if(i == 0){
-                    weights[i][j][k] += lr * delta[i][j] * input[k];
-                }else{
-                    weights[i][j][k] += lr * delta[i][j] * afterActivation[i-1][k];
+        sz += 3 * arena_pad<T>((size_t)batch_size * layer_sz[i+1]);
+    }
+    aligned_delete(batch_arena);
+    batch_arena = arena_alloc<T>(sz);
+    batch_cap = batch_size;
+
+    T* p = batch_arena;
+    batchInput = p;
+    p += arena_pad<T>((size_t)batch_size * layer_sz[0]);
+    for(int i = 0; i < layer_n; i++){
+        batchBefore[i] = p;
+        p += arena_pad<T>((size_t)batch_size * layer_sz[i+1]);
+        batchAfter[i] = p;
+        p += arena_pad<T>((size_t)batch_size * layer_sz[i+1]);
+        batchDelta[i] = p;
+        p += arena_pad<T>((size_t)batch_size * layer_sz[i+1]);
+    }
+}
+
+// Runs the first b rows of batchInput through the network
+template<typename T>
+void FNN<T>::batch_forward(int b){
+    Vec<T> input = batchInput;
+    for(int i = 0; i < layer_n; i++){
+        int in = layer_sz[i], out = layer_sz[i+1];
+        PROF_START(t0);
+        gemm(false, true, b, out, in, 1, input, in, weights_flat[i], in, 0, batchBefore[i], out);
+        PROF_STOP(t0, layer_stats, i, PROF_FORWARD, 2.0 * b * out * in, ((double)out * in + (double)b * (in + out)) * sizeof(T));
+        PROF_START(t1);
+        act_layer(batchBefore[i], batchAfter[i], b * out);
+        PROF_STOP(t1, layer_stats, i, PROF_ACTIVATION, (double)b * out, 2.0 * b * out * sizeof(T));
+        input = batchAfter[i];
+    }
+}
+
+// Trains on the first b rows of batchInput, their targets are expected in batchDelta[layer_n-1]
+template<typename T>
+void FNN<T>::batch_step(int b, double lr){
+    int out = layer_sz[layer_n];
+    batch_forward(b);
+
+    // Update deltas
+    Vec<T> output = batchAfter[layer_n-1];
+    Vec<T> last = batchDelta[layer_n-1];
+    PROF_START(t_out);
+    for(size_t k = 0; k < (size_t)b * out; k++){
+        last[k] = last[k] - output[k];
+    }
+    act_d_layer(batchBefore[layer_n-1], batchAfter[layer_n-1], last, b * out);
+    PROF_STOP(t_out, layer_stats, layer_n-1, PROF_DELTA, 2.0 * b * out, 4.0 * b * out * sizeof(T));
+    for(int i = layer_n-2; i >= 0; i--){
+        int sz = layer_sz[i+1], next = layer_sz[i+2];
+        // Streams weights_flat[i+1], charged to layer i+1 like in deltas()
+        PROF_START(t0);
+        gemm(false, false, b, sz, next, 1, batchDelta[i+1], next, weights_flat[i+1], sz, 0, batchDelta[i], sz);
+        PROF_STOP(t0, layer_stats, i+1, PROF_DELTA, 2.0 * next * b * sz, ((double)next * sz + (double)b * (next + sz)) * sizeof(T));
+        PROF_START(t1);
+        act_d_layer(batchBefore[i], batchAfter[i], batchDelta[i], b * sz);
+        PROF_STOP(t1, layer_stats, i, PROF_DELTA, (double)b * sz, 3.0 * b * sz * sizeof(T));
+    }
+
+    // Update weights with the batch average
+    for(int i = 0; i < layer_n; i++){
+        int in = layer_sz[i], sz = layer_sz[i+1];
+        Vec<T> prev = i == 0 ? batchInput : batchAfter[i-1];
+        PROF_START(t_up);
+        gemm(true, false, sz, in, b, T(lr / b), batchDelta[i], sz, prev, in, 1, weights_flat[i], in);
+        PROF_STOP(t_up, layer_stats, i, PROF_UPDATE, 2.0 * b * sz * in, (2.0 * sz * in + (double)b * (in + sz)) * sizeof(T));
+    }
+}
+
+template<typename T>
+void FNN<T>::train_batch(Data_Entry<T>* dataset, int n, int batch_size, int epochs, double& lr){
+    check_batch_size(batch_size);
+    reserve_batch(batch_size);
+    int in = layer_sz[0], out = layer_sz[layer_n];
+
+    for(int e = 0; e < epochs; e++){
+        for(int s = 0; s < n; s += batch_size){
+            int b = min(batch_size, n - s);
+            for(int r = 0; r < b; r++){
+                Vec<T> row = batchInput + (size_t)r * in;
+                for(int k = 0; k < in-1; k++){
+                    row[k] = dataset[s+r].first[k];
+                }
+                row[in-1] = 1;
+                Vec<T> target = batchDelta[layer_n-1] + (size_t)r * out;
+                for(int j = 0; j < out; j++){
+                    target[j] = dataset[s+r].second[j];
                 }
             }
+            batch_step(b, lr);
         }
+        end_epoch(lr);
     }
 }
 
-void FNN::train(Data_Entry* dataset, int n, int epochs, double& lr){
+// Rows are gathered through the visiting order, two streams from two blocks instead of 2b pointer chases
+template<typename T>
+void FNN<T>::train_batch(Dataset<T>& data, int batch_size, int epochs, double& lr, bool shuffle){
+    check_batch_size(batch_size);
+    check_widths("Dataset", data.in, data.out, layer_sz[0]-1, layer_sz[layer_n]);
+    reserve_batch(batch_size);
+    int in = layer_sz[0], out = layer_sz[layer_n];
+
     for(int e = 0; e < epochs; e++){
-        for(int i = 0; i < n; i++){
-            backward(dataset[i].first, dataset[i].second, lr);
+        if(shuffle) data.shuffle();
+        for(int s = 0; s < data.n; s += batch_size){
+            int b = min(batch_size, data.n - s);
+            for(int r = 0; r < b; r++){
+                const T* x = data.input_at(s+r);
+                const T* y = data.target_at(s+r);
+                Vec<T> row = batchInput + (size_t)r * in;
+                for(int k = 0; k < in-1; k++){
+                    row[k] = x[k];
+                }
+                row[in-1] = 1;
+                Vec<T> target = batchDelta[layer_n-1] + (size_t)r * out;
+                for(int j = 0; j < out; j++){
+                    target[j] = y[j];
+                }
+            }
+            batch_step(b, lr);
+        }
+        end_epoch(lr);
+    }
+}
+
+template<typename T>
+void FNN<T>::train_batch(DatasetStream<T>& data, int batch_size, int epochs, double& lr){
+    check_batch_size(batch_size);
+    check_widths("DatasetStream", data.in, data.out, layer_sz[0]-1, layer_sz[layer_n]);
+    reserve_batch(batch_size);
+    int in = layer_sz[0], out = layer_sz[layer_n];
+    const T* x;
+    const T* y;
+
+    for(int e = 0; e < epochs; e++){
+        data.rewind();
+        bool more = true;
+        while(more){
+            int b = 0;
+            while(b < batch_size && (more = data.next(x, y))){
+                Vec<T> row = batchInput + (size_t)b * in;
+                for(int k = 0; k < in-1; k++){
+                    row[k] = x[k];
+                }
+                row[in-1] = 1;
+                Vec<T> target = batchDelta[layer_n-1] + (size_t)b * out;
+                for(int j = 0; j < out; j++){
+                    target[j] = y[j];
+                }
+                b++;
+            }
+            if(b > 0) batch_step(b, lr);
+        }
+        end_epoch(lr);
+    }
+}
+
+// The producer writes batches in the layout batch_step reads, so they are trained in place
+template<typename T>
+void FNN<T>::train_batch(BatchPrefetcher<T>& feed, int epochs, double& lr){
+    check_batch_size(feed.batch_size);
+    check_widths("BatchPrefetcher", feed.in, feed.out, layer_sz[0]-1, layer_sz[layer_n]);
+    reserve_batch(feed.batch_size);
+    Vec<T> own_input = batchInput;
+    Vec<T> own_target = batchDelta[layer_n-1];
+
+    feed.start(epochs);
+    for(int e = 0; e < epochs; e++){
+        bool last = false;
+        while(!last){
+            PrefetchBatch<T>* b = feed.acquire();
+            last = b->last;
+            if(b->rows > 0){
+                batchInput = b->inputs;
+                batchDelta[layer_n-1] = b->targets;
+                batch_step(b->rows, lr);
+            }
+            feed.release(b);
         }
-        if(e % 50 == 0) lr *= 0.99;
+        end_epoch(lr);
     }
+    feed.finish();
+
+    batchInput = own_input;
+    batchDelta[layer_n-1] = own_target;
 }
 
+// Each layer is one GEMM over a chunk of samples, so the weights are read once per chunk
+template<typename T>
+void FNN<T>::forward_batch(const T* inputs, int n, T* outputs){
+    if(batch_cap == 0) reserve_batch(FORWARD_BATCH);
+    int in = layer_sz[0], out = layer_sz[layer_n];
+
+    for(int s = 0; s < n; s += batch_cap){
+        int b = min(batch_cap, n - s);
+
+        // Inputs
+        for(int r = 0; r < b; r++){
+            const T* src = inputs + (size_t)(s+r) * (in-1);
+            Vec<T> row = batchInput + (size_t)r * in;
+            for(int k = 0; k < in-1; k++){
+                row[k] = src[k];
+            }
+            row[in-1] = 1;
+        }
+        batch_forward(b);
 
+        // Outputs
+        Vec<T> result = batchAfter[layer_n-1];
+        T* dst = outputs + (size_t)s * out;
+        for(size_t k = 0; k < (size_t)b * out; k++){
+            dst[k] = result[k];
+        }
+    }
+}
 
-double FNN::loss(Vec output, Vec expected){
+
+
+template<typename T>
+double FNN<T>::loss(Vec<T> output, Vec<T> expected){
     double res = 0;
     for(int i = 0; i < layer_sz[layer_n]; i++){
         res += (output[i] - expected[i]) * (output[i] - expected[i]);
     }
     return res / layer_sz[layer_n];
-}
\ No newline at end of file
+}
+
+// ================== Profile ==================
+
+template<typename T>
+const LayerStats* FNN<T>::stats(){
+    return layer_stats;
+}
+
+template<typename T>
+void FNN<T>::reset_stats(){
+    if(layer_stats != nullptr) fill(layer_stats, layer_stats + layer_n, LayerStats());
+}
+
+// One line per layer and phase, with each one's share of the counted cycles
+template<typename T>
+string FNN<T>::stats_report(){
+    if(layer_stats == nullptr) return "Profile not built in, compile with -DFNN_PROFILE\n";
+    const char* names[PROF_PHASES] = {"forward", "activation", "delta", "update"};
+    double total = 0;
+    for(int i = 0; i < layer_n; i++){
+        for(int p = 0; p < PROF_PHASES; p++) total += layer_stats[i].phases[p].cycles;
+    }
+
+    // Rows follow the weight matrices, see profile.hpp, so layer i+1's delta holds the product that feeds layer i
+    string res = "delta of layer i+1 includes weights[i+1]^T * delta[i+1], the derivative is layer i's\n";
+    char line[160];
+    snprintf(line, sizeof(line), "%-6s %-11s %10s %14s %12s %12s %8s\n", "layer", "phase", "calls", "cycles/call", "flops/cycle", "bytes/cycle", "share");
+    res += line;
+    for(int i = 0; i < layer_n; i++){
+        for(int p = 0; p < PROF_PHASES; p++){
+            const PhaseStats& s = layer_stats[i].phases[p];
+            if(s.calls == 0) continue;
+            double cycles = max((double)s.cycles, 1.0);
+            snprintf(line, sizeof(line), "%-6d %-11s %10lld %14.1f %12.2f %12.2f %7.1f%%\n", i, names[p], s.calls,
+                cycles / s.calls, s.flops / cycles, s.bytes / cycles, 100 * cycles / max(total, 1.0));
+            res += line;
+        }
+    }
+    return res;
+}
+
+// ================== Model File ==================
+
+uint64_t model_checksum(const void* data, size_t n, uint64_t h){
+    const uint64_t* w = (const uint64_t*)data;
+    for(size_t i = 0; i < n / 8; i++){
+        h ^= w[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+template<typename T>
+static uint32_t model_dtype(){
+    return sizeof(T) == sizeof(float) ? MODEL_FLOAT : MODEL_DOUBLE;
+}
+
+// Bytes of ModelHeader a given version wrote, the sizes start right after it
+static size_t model_header_fields(uint32_t version){
+    return version == 1 ? offsetof(ModelHeader, epoch) : sizeof(ModelHeader);
+}
+
+// Header plus sizes, rounded up so the first weight block is aligned
+static size_t model_header_size(int layer_n, uint32_t version = MODEL_VERSION){
+    size_t sz = model_header_fields(version) + sizeof(uint32_t) * (layer_n + 1);
+    return (sz + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+}
+
+// Writes next to path and renames over it once everything is on disk, so a crash never leaves half a model
+static void write_model_file(const string& path, const void* head, size_t head_sz, const void* data, size_t data_sz){
+    string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) throw runtime_error("Cannot write model file " + tmp);
+
+    const char* parts[] = {(const char*)head, (const char*)data};
+    size_t sizes[] = {head_sz, data_sz};
+    for(int i = 0; i < 2; i++){
+        size_t done = 0;
+        while(done < sizes[i]){
+            ssize_t w = write(fd, parts[i] + done, sizes[i] - done);
+            if(w < 0){
+                close(fd);
+                throw runtime_error("Cannot write model file " + tmp);
+            }
+            done += w;
+        }
+    }
+    if(fsync(fd) != 0 || close(fd) != 0) throw runtime_error("Cannot write model file " + tmp);
+    if(rename(tmp.c_str(), path.c_str()) != 0) throw runtime_error("Cannot rename model file to " + path);
+}
+
+// Bytes of the weight blocks in the file, the same padding as the arena
+template<typename T>
+size_t FNN<T>::model_size(){
+    size_t sz = 0;
+    for(int i = 0; i < layer_n; i++){
+        sz += arena_pad<T>((size_t)layer_sz[i+1] * layer_sz[i]) * sizeof(T);
+    }
+    return sz;
+}
+
+// Copies the weights into dst in file layout, padding zeroed
+template<typename T>
+void FNN<T>::snapshot(T* dst){
+    for(int i = 0; i < layer_n; i++){
+        size_t n = (size_t)layer_sz[i+1] * layer_sz[i];
+        size_t padded = arena_pad<T>(n);
+        memcpy(dst, weights_flat[i], n * sizeof(T));
+        fill(dst + n, dst + padded, T(0));
+        dst += padded;
+    }
+}
+
+template<typename T>
+ModelHeader FNN<T>::model_header(){
+    ModelHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MODEL_MAGIC, sizeof(h.magic));
+    h.version = MODEL_VERSION;
+    h.header_size = model_header_size(layer_n);
+    h.dtype = model_dtype<T>();
+    h.activation = act_type;
+    h.layer_n = layer_n;
+    h.data_size = model_size();
+    h.lr = lr;
+    h.epoch = epoch;
+    return h;
+}
+
+// Fills in the checksum and writes header, sizes and the snapshot in one go
+template<typename T>
+void FNN<T>::write_model(const string& path, ModelHeader h, const int* layer_sz, const T* data){
+    h.checksum = 0;
+    vector<char> head(h.header_size, 0);
+    memcpy(head.data(), &h, sizeof(h));
+    uint32_t* sizes = (uint32_t*)(head.data() + sizeof(h));
+    for(uint32_t i = 0; i <= h.layer_n; i++) sizes[i] = layer_sz[i];
+
+    h.checksum = model_checksum(data, h.data_size, model_checksum(head.data(), head.size()));
+    memcpy(head.data() + offsetof(ModelHeader, checksum), &h.checksum, sizeof(h.checksum));
+
+    write_model_file(path, head.data(), head.size(), data, h.data_size);
+}
+
+template<typename T>
+void FNN<T>::save(const string& path){
+    ModelHeader h = model_header();
+    T* data = arena_alloc<T>(h.data_size / sizeof(T));
+    snapshot(data);
+    try{
+        write_model(path, h, layer_sz, data);
+    }catch(...){
+        aligned_delete(data);
+        throw;
+    }
+    aligned_delete(data);
+}
+
+template<typename T>
+FNN<T> FNN<T>::load_mmap(const string& path, bool verify){
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) throw runtime_error("Cannot open model file " + path);
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < model_header_fields(1)){
+        close(fd);
+        throw runtime_error("Model file too small: " + path);
+    }
+    size_t file_sz = st.st_size;
+    void* map = mmap(nullptr, file_sz, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) throw runtime_error("Cannot map model file " + path);
+
+    // Everything is checked before a single weight is trusted, every size against the file before it is used
+    // Older versions wrote a prefix of the header, the missing fields read as zero
+    ModelHeader hv;
+    memset(&hv, 0, sizeof(hv));
+    const ModelHeader* h = &hv;
+    memcpy(&hv, map, model_header_fields(1));
+    size_t fields = model_header_fields(h->version);
+    string error;
+    if(memcmp(h->magic, MODEL_MAGIC, sizeof(h->magic)) != 0) error = "not a model file";
+    else if(h->version < 1 || h->version > MODEL_VERSION) error = "unsupported version " + to_string(h->version);
+    else if(file_sz < fields) error = "truncated";
+    else if(h->dtype != model_dtype<T>()) error = "scalar type does not match";
+    else if(h->activation != _relu && h->activation != _sigmoid) error = "unknown activation " + to_string(h->activation);
+    else if(h->layer_n < 1 || h->layer_n >= (file_sz - fields) / sizeof(uint32_t)) error = "bad layer count";
+    else if(h->header_size < model_header_size(h->layer_n, h->version) || h->header_size % ARENA_ALIGN != 0) error = "bad header";
+    else if(h->header_size > file_sz || h->data_size > file_sz - h->header_size) error = "truncated";
+    if(error.empty()) memcpy(&hv, map, fields);
+    const uint32_t* sizes = (const uint32_t*)((const char*)map + fields);
+    if(error.empty()){
+        // Checked 64-bit arithmetic, a forged size must not wrap around to something that matches data_size
+        size_t expected = 0;
+        for(uint32_t i = 0; i <= h->layer_n && error.empty(); i++){
+            if(sizes[i] < 1 || sizes[i] > (uint32_t)INT_MAX) error = "bad layer size";
+        }
+        for(uint32_t i = 0; i < h->layer_n && error.empty(); i++){
+            size_t n;
+            if(__builtin_mul_overflow((size_t)sizes[i+1], (size_t)sizes[i], &n) || n > h->data_size / sizeof(T)
+               || __builtin_add_overflow(expected, arena_pad<T>(n) * sizeof(T), &expected)) error = "layer sizes do not match the data";
+        }
+        if(error.empty() && expected != h->data_size) error = "layer sizes do not match the data";
+    }
+    T* blocks = (T*)((char*)map + (error.empty() ? h->header_size : 0));
+    if(error.empty() && verify){
+        uint64_t sum = MODEL_CHECKSUM_SEED;
+        if(h->version >= 3){
+            // The header as it was written, with the checksum field still zero
+            uint64_t zero = 0;
+            size_t rest = offsetof(ModelHeader, checksum) + sizeof(zero);
+            sum = model_checksum(map, offsetof(ModelHeader, checksum));
+            sum = model_checksum(&zero, sizeof(zero), sum);
+            sum = model_checksum((const char*)map + rest, h->header_size - rest, sum);
+        }
+        if(model_checksum(blocks, h->data_size, sum) != h->checksum) error = "checksum mismatch";
+    }
+    if(!error.empty()){
+        munmap(map, file_sz);
+        throw runtime_error("Bad model file " + path + ": " + error);
+    }
+
+    // init() adds the bias back to the input size
+    int layer_n = h->layer_n;
+    int* layer_sz = new int[layer_n + 1];
+    for(int i = 0; i <= layer_n; i++) layer_sz[i] = sizes[i];
+    layer_sz[0]--;
+
+    FNN<T> nn(layer_n, layer_sz, h->activation, h->lr, blocks);
+    nn.owned_sz = layer_sz;
+    nn.mapping = map;
+    nn.mapping_sz = file_sz;
+    nn.epoch = h->epoch;
+    return nn;
+}
+
+// ================== Instantiations ==================
+
+template string to_string(Vec<float> v, int n);
+template string to_string(Vec<double> v, int n);
+template string to_string(Mat<float> ma, int n, int m);
+template string to_string(Mat<double> ma, int n, int m);
+template string to_string(Net<float> n, int* sizes, int am);
+template string to_string(Net<double> n, int* sizes, int am);
+
+template float relu(float x);
+template double relu(double x);
+template float relu_d(float x, float y);
+template double relu_d(double x, double y);
+template float sigmoid(float x);
+template double sigmoid(double x);
+template float sigmoid_d(float x, float y);
+template double sigmoid_d(double x, double y);
+
+template class FNN<float>;
+template class FNN<double>;
@@ -2,18 +2,22 @@
 #define FNN_HPP
 
 #include <string>
+#include <cstddef>
+#include <cstdint>
+#include "kernels.hpp"
+#include "profile.hpp"
 
 using namespace std;
 
 // ================== Structures ==================
 
-// Neural Network Architecture
-#define Vec double*
-#define Mat Vec*
-#define Net Mat*
+// Neural Network Architecture, T is the scalar type (float or double)
+template<typename T> using Vec = T*;
+template<typename T> using Mat = Vec<T>*;
+template<typename T> using Net = Mat<T>*;
 
 // Data Entry
-#define Data_Entry pair<Vec, Vec>
+template<typename T> using Data_Entry = pair<Vec<T>, Vec<T>>;
 
 // ================== Global Variables ==================
 
@@ -21,54 +25,195 @@ using namespace std;
 #define _relu 1
 #define _sigmoid 0
 
+// Memory
+#define ARENA_ALIGN 64
+
+// Rows per GEMM in forward_batch when no batch size was reserved
+#define FORWARD_BATCH 256
+
+// Model file
+#define MODEL_MAGIC "FNNMODEL"
+#define MODEL_VERSION 3 // 2 added epoch, 3 checksums the header too
+#define MODEL_FLOAT 1
+#define MODEL_DOUBLE 2
+#define MODEL_CHECKSUM_SEED 14695981039346656037ull // FNV-1a offset basis
+
 // ================== Function Definitions ==================
 
 // Utils
-string to_string(Vec v, int n);
-string to_string(Mat ma, int n, int m);
-string to_string(Net n, int* sizes, int am);
+template<typename T> string to_string(Vec<T> v, int n);
+template<typename T> string to_string(Mat<T> ma, int n, int m);
+template<typename T> string to_string(Net<T> n, int* sizes, int am);
 
 // Activation Functions
-double relu(double x);
-double relu_d(double x, double y);
-double sigmoid(double x);
-double sigmoid_d(double x, double y);
+template<typename T> T relu(T x);
+template<typename T> T relu_d(T x, T y);
+template<typename T> T sigmoid(T x);
+template<typename T> T sigmoid_d(T x, T y);
 
 // ================== Neural Network Class ==================
 
+// Model file layout: this header, layer_n+1 uint32 layer sizes (bias included) and zero padding up to
+// header_size, then every layer's weights row-major, each block padded to ARENA_ALIGN bytes like in the arena
+struct ModelHeader {
+char magic[8];
+uint32_t version;
+uint32_t header_size;
+uint32_t dtype;       // MODEL_FLOAT or MODEL_DOUBLE
+uint32_t activation;
+uint32_t layer_n;
+uint32_t reserved;
+uint64_t data_size;   // bytes of weight blocks after the header
+uint64_t checksum;    // model_checksum of header_size bytes (this field zero) then the weight blocks, before 3 only the blocks
+double lr;
+uint64_t epoch;
+};
+
+// 64-bit FNV-1a over whole words, n must be a multiple of 8
+// Pass the result of one call as h to continue it over the next buffer
+uint64_t model_checksum(const void* data, size_t n, uint64_t h = MODEL_CHECKSUM_SEED);
+
+// Forward and gradient buffers of one sample, the FNN's own members are the calling thread's
+template<typename T>
+struct Scratch {
+T* arena; // owned only when made by make_scratch
+Vec<T> input;
+Vec<T>* before;
+Vec<T>* after;
+Vec<T>* delta;
+};
+
+template<typename T> class Checkpointer;
+template<typename T> class Dataset;
+template<typename T> class DatasetStream;
+template<typename T> class BatchPrefetcher;
+
+// Instantiated for float and double in FNN.cpp
+template<typename T>
 class FNN {
 public:
 // Structure
 int layer_n;
 int* layer_sz;
 int act_type;
-double lr;
+double lr;          // follows the lr passed to the training functions after every epoch
+long long epoch;    // epochs trained so far, the lr decay counts from it
+
+// Notified after every epoch when set, see checkpoint.hpp
+Checkpointer<T>* checkpointer;
+
+// Whole-layer activation kernels, picked for this CPU in init()
+typename ActKernels<T>::Act act_layer;
+typename ActKernels<T>::ActD act_d_layer;
+
+// Memory arena, one aligned slab holding every weight and layer buffer
+T* arena;
+size_t arena_sz;
 
 // Network weights
-Net weights;
+Net<T> weights;        // row views, weights[i][j] is row j of layer i
+Vec<T>* weights_flat;  // weights_flat[i] is layer i, row-major layer_sz[i+1] x layer_sz[i]
 
 // Forward data
-Vec* beforeActivation;
-Vec* afterActivation;
+Vec<T> biasInput; // last input with the bias appended
+Vec<T>* beforeActivation;
+Vec<T>* afterActivation;
 // Gradient data
-Vec* delta;
+Vec<T>* delta;
+
+// Set when the weights live in a mapped model file instead of the arena
+void* mapping;
+size_t mapping_sz;
+int* owned_sz; // layer sizes read from the file
+
+// Hot path counters, layer_n entries when built with FNN_PROFILE and null otherwise, see profile.hpp
+LayerStats* layer_stats;
+
+// Batch data, rows are samples, sized for batch_cap samples
+T* batch_arena;
+int batch_cap;
+Vec<T> batchInput; // bias column included
+Vec<T>* batchBefore;
+Vec<T>* batchAfter;
+Vec<T>* batchDelta;
 
     // Setup
     FNN(int layer_n, int* layer_sz, int activation, double lr);
-    void init();
+    FNN(FNN&& other);
+    FNN(const FNN&) = delete;
+    FNN& operator=(const FNN&) = delete;
+    ~FNN();
+    // weight_blocks are laid out as in the model file and used in place, otherwise the weights are random
+    void init(T* weight_blocks = nullptr);
+
+    // Model file, load_mmap maps the file and points the weights straight into it
+    // Pages are copy-on-write, so training a loaded model never touches the file
+    // verify reads every weight to check the checksum, skip it to only pay for the pages that get used
+    FNN(int layer_n, int* layer_sz, int activation, double lr, T* weight_blocks);
+    size_t model_size();
+    void snapshot(T* dst);
+    ModelHeader model_header();
+    void save(const string& path);
+    static FNN load_mmap(const string& path, bool verify = true);
+    static void write_model(const string& path, ModelHeader h, const int* layer_sz, const T* data);
 
     // Activation Functions
-    double activation(double x);
-    double activation_d(double x, double y);
+    T activation(T x);
+    T activation_d(T x, T y);
 
     // Neural Network Functions
-    Vec add_bias(Vec v);
-    Vec forward(Vec input);
-    void backward(Vec input, Vec result, double lr);
-    void train(Data_Entry* dataset, int n, int epochs, double& lr);
+    Vec<T> add_bias(Vec<T> v);
+    Vec<T> forward(Vec<T> input);
+    void backward(Vec<T> input, Vec<T> result, double lr);
+    // Trains on the input of the last forward(), reusing its activations
+    void backward_cached(Vec<T> result, double lr);
+    void train(Data_Entry<T>* dataset, int n, int epochs, double& lr);
+    // Walks data in its visiting order, shuffle reorders it before every epoch, see dataset.hpp
+    void train(Dataset<T>& data, int epochs, double& lr, bool shuffle = false);
+    // Streams a dataset file once per epoch, see dataset_file.hpp
+    void train(DatasetStream<T>& data, int epochs, double& lr);
+    void end_epoch(double& lr);
+
+    // Same as above on caller-owned buffers, so several threads can run at once
+    Scratch<T> own_scratch();
+    Scratch<T> make_scratch();
+    void free_scratch(Scratch<T>& s);
+    Vec<T> forward(Vec<T> input, Scratch<T>& s);
+    void backward(Vec<T> input, Vec<T> result, double lr, Scratch<T>& s);
+    void backward_cached(Vec<T> result, double lr, Scratch<T>& s);
+    void deltas(Vec<T> input, Vec<T> result, Scratch<T>& s);
+
+    // Hogwild, every thread trains on its own shard and updates the shared weights without locks, a data race by design
+    // The threads meet at the end of every epoch, where end_epoch decays lr and runs the checkpointer
+    // Both run on thread_pool(), threads <= 0 uses every core
+    void train_parallel(Data_Entry<T>* dataset, int n, int epochs, double& lr, int threads);
+
+    // Synchronous data-parallel mini-batches, the batch is cut into threads slices whose gradients are summed
+    // by a tree reduction and applied once, split over row slices. Bit-identical between runs for a fixed thread count
+    void train_sync(Data_Entry<T>* dataset, int n, int batch_size, int epochs, double& lr, int threads);
+
+    // Mini-batch Functions, call reserve_batch up front to keep the first train_batch allocation free
+    void reserve_batch(int batch_size);
+    void batch_forward(int b);
+    void batch_step(int b, double lr);
+    void train_batch(Data_Entry<T>* dataset, int n, int batch_size, int epochs, double& lr);
+    void train_batch(Dataset<T>& data, int batch_size, int epochs, double& lr, bool shuffle = false);
+    void train_batch(DatasetStream<T>& data, int batch_size, int epochs, double& lr);
+    // Batches are built on another thread while the previous one trains, see prefetch.hpp
+    void train_batch(BatchPrefetcher<T>& feed, int epochs, double& lr);
+
+    // Batched inference, inputs and outputs are row-major blocks of n samples without the bias column
+    void forward_batch(const T* inputs, int n, T* outputs);
 
     // Loss
-    double loss(Vec output, Vec expected);
+    double loss(Vec<T> output, Vec<T> expected);
+
+    // Profile, empty unless built with FNN_PROFILE. Only the calling thread's buffers are counted,
+    // so the parallel trainers report the share of the thread that uses them
+    // A layer's row covers the work on its own weight matrix, the delta through layer i+1's weights is layer i+1's
+    const LayerStats* stats();
+    void reset_stats();
+    string stats_report();
 };
 
-#endif
\ No newline at end of file
+#endif
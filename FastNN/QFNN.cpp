@@ -0,0 +1,253 @@
+#include "QFNN.hpp"
+#include "memory.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// ================== Utils ==================
+
+string to_string(const QuantReport& r){
+    string res = "";
+    res += "loss: " + to_string(r.loss_float) + " -> " + to_string(r.loss_quant) + "\n";
+    res += "accuracy: " + to_string(r.accuracy_float) + " -> " + to_string(r.accuracy_quant) + "\n";
+    res += "agreement: " + to_string(r.agreement) + "\n";
+    res += "max output diff: " + to_string(r.max_diff) + "\n";
+    res += "size: " + to_string(r.bytes_float) + " -> " + to_string(r.bytes_quant) + " bytes";
+    return res;
+}
+
+static int pad_row(int n){
+    return (n + QUANT_ROW_ALIGN - 1) / QUANT_ROW_ALIGN * QUANT_ROW_ALIGN;
+}
+
+static int argmax(const double* v, int n){
+    return (int)(max_element(v, v + n) - v);
+}
+
+// ================== Int8 Kernels ==================
+
+// Lengths are multiples of QUANT_ROW_ALIGN, padding is zero on both sides
+
+static int32_t dot_s8_scalar(const int8_t* a, const int8_t* b, int n){
+    int32_t sum = 0;
+    for(int i = 0; i < n; i++){
+        sum += (int32_t)a[i] * b[i];
+    }
+    return sum;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Widens to int16 and uses madd, pairs of products land in int32 lanes
+__attribute__((target("avx2")))
+static int32_t dot_s8_avx2(const int8_t* a, const int8_t* b, int n){
+    __m256i acc = _mm256_setzero_si256();
+    for(int i = 0; i < n; i += 32){
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i alo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(va));
+        __m256i ahi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(va, 1));
+        __m256i blo = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(vb));
+        __m256i bhi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(vb, 1));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(alo, blo));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(ahi, bhi));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+#endif
+
+static int32_t dot_s8(const int8_t* a, const int8_t* b, int n){
+#if defined(__x86_64__) || defined(__i386__)
+    static int32_t (*const kernel)(const int8_t*, const int8_t*, int) = cpu_isa() >= ISA_AVX2 ? dot_s8_avx2 : dot_s8_scalar;
+    return kernel(a, b, n);
+#else
+    return dot_s8_scalar(a, b, n);
+#endif
+}
+
+template<typename T>
+static void quantize(const T* x, int n, T scale, int8_t* q){
+    T inv = 1 / scale;
+    for(int i = 0; i < n; i++){
+        long v = lrint(x[i] * inv);
+        q[i] = (int8_t)max(-127L, min(127L, v));
+    }
+}
+
+// ================== Quantized Neural Network Class ==================
+
+template<typename T>
+QuantizedFNN<T>::QuantizedFNN(FNN<T>& nn, Data_Entry<T>* calibration, int n){
+    layer_n = nn.layer_n;
+    act_type = nn.act_type;
+    const ActKernels<T>& kernels = act_kernels<T>();
+    act_layer = act_type == _relu ? kernels.relu : kernels.sigmoid;
+
+    layer_sz = new int[layer_n+1];
+    row_stride = new int[layer_n];
+    for(int i = 0; i <= layer_n; i++) layer_sz[i] = nn.layer_sz[i];
+    for(int i = 0; i < layer_n; i++) row_stride[i] = pad_row(layer_sz[i]);
+
+    // Calibration, largest magnitude seen at the input of every layer
+    in_scale = new T[layer_n];
+    for(int i = 0; i < layer_n; i++) in_scale[i] = 0;
+    for(int s = 0; s < n; s++){
+        nn.forward(calibration[s].first);
+        for(int k = 0; k < layer_sz[0]-1; k++){
+            in_scale[0] = max(in_scale[0], (T)fabs(calibration[s].first[k]));
+        }
+        for(int i = 1; i < layer_n; i++){
+            for(int k = 0; k < layer_sz[i]; k++){
+                in_scale[i] = max(in_scale[i], (T)fabs(nn.afterActivation[i-1][k]));
+            }
+        }
+    }
+    for(int i = 0; i < layer_n; i++){
+        in_scale[i] = in_scale[i] > 0 ? in_scale[i] / 127 : 1;
+    }
+
+    // Weights and input buffers share one slab
+    arena_sz = 0;
+    for(int i = 0; i < layer_n; i++){
+        arena_sz += (size_t)layer_sz[i+1] * row_stride[i] + row_stride[i];
+    }
+    arena = aligned_new<int8_t>(arena_sz);
+    memset(arena, 0, arena_sz);
+
+    qweights = new int8_t*[layer_n];
+    qinput = new int8_t*[layer_n];
+    row_scale = new T*[layer_n];
+    bias = new T[layer_sz[1]];
+    beforeActivation = new Vec<T>[layer_n];
+    afterActivation = new Vec<T>[layer_n];
+
+    int8_t* q = arena;
+    for(int i = 0; i < layer_n; i++){
+        qweights[i] = q;
+        q += (size_t)layer_sz[i+1] * row_stride[i];
+        qinput[i] = q;
+        q += row_stride[i];
+
+        // The bias column of layer 0 stays zero in the int8 rows
+        int cols = i == 0 ? layer_sz[0]-1 : layer_sz[i];
+        row_scale[i] = new T[layer_sz[i+1]];
+        for(int j = 0; j < layer_sz[i+1]; j++){
+            Vec<T> w = nn.weights_flat[i] + (size_t)j * layer_sz[i];
+            T m = 0;
+            for(int k = 0; k < cols; k++) m = max(m, (T)fabs(w[k]));
+            T scale = m > 0 ? m / 127 : 1;
+            quantize(w, cols, scale, qweights[i] + (size_t)j * row_stride[i]);
+            row_scale[i][j] = scale * in_scale[i];
+            if(i == 0) bias[j] = w[layer_sz[0]-1];
+        }
+
+        beforeActivation[i] = new T[layer_sz[i+1]];
+        afterActivation[i] = new T[layer_sz[i+1]];
+    }
+}
+
+template<typename T>
+QuantizedFNN<T>::~QuantizedFNN(){
+    for(int i = 0; i < layer_n; i++){
+        delete[] row_scale[i];
+        delete[] beforeActivation[i];
+        delete[] afterActivation[i];
+    }
+    delete[] row_scale;
+    delete[] bias;
+    delete[] beforeActivation;
+    delete[] afterActivation;
+    delete[] qweights;
+    delete[] qinput;
+    delete[] in_scale;
+    delete[] row_stride;
+    delete[] layer_sz;
+    aligned_delete(arena);
+}
+
+template<typename T>
+Vec<T> QuantizedFNN<T>::forward(Vec<T> input){
+    quantize(input, layer_sz[0]-1, in_scale[0], qinput[0]);
+
+    for(int i = 0; i < layer_n; i++){
+        for(int j = 0; j < layer_sz[i+1]; j++){
+            int32_t acc = dot_s8(qweights[i] + (size_t)j * row_stride[i], qinput[i], row_stride[i]);
+            beforeActivation[i][j] = acc * row_scale[i][j] + (i == 0 ? bias[j] : 0);
+        }
+        act_layer(beforeActivation[i], afterActivation[i], layer_sz[i+1]);
+        if(i < layer_n-1){
+            quantize(afterActivation[i], layer_sz[i+1], in_scale[i+1], qinput[i+1]);
+        }
+    }
+    return afterActivation[layer_n-1];
+}
+
+template<typename T>
+size_t QuantizedFNN<T>::size_bytes(){
+    size_t res = arena_sz + layer_n * sizeof(T) + layer_sz[1] * sizeof(T);
+    for(int i = 0; i < layer_n; i++) res += layer_sz[i+1] * sizeof(T);
+    return res;
+}
+
+template<typename T>
+QuantReport QuantizedFNN<T>::compare(FNN<T>& nn, Data_Entry<T>* dataset, int n){
+    QuantReport r = {};
+    int out = layer_sz[layer_n];
+    double* f = new double[out];
+    double* q = new double[out];
+    double* e = new double[out];
+    for(int s = 0; s < n; s++){
+        Vec<T> of = nn.forward(dataset[s].first);
+        r.loss_float += nn.loss(of, dataset[s].second);
+        for(int j = 0; j < out; j++) f[j] = of[j];
+
+        Vec<T> oq = forward(dataset[s].first);
+        r.loss_quant += loss(oq, dataset[s].second);
+        for(int j = 0; j < out; j++) q[j] = oq[j];
+
+        for(int j = 0; j < out; j++){
+            e[j] = dataset[s].second[j];
+            r.max_diff = max(r.max_diff, fabs(f[j] - q[j]));
+        }
+        int expected = argmax(e, out);
+        r.accuracy_float += argmax(f, out) == expected;
+        r.accuracy_quant += argmax(q, out) == expected;
+        r.agreement += argmax(f, out) == argmax(q, out);
+    }
+    delete[] f;
+    delete[] q;
+    delete[] e;
+
+    r.loss_float /= n;
+    r.loss_quant /= n;
+    r.accuracy_float /= n;
+    r.accuracy_quant /= n;
+    r.agreement /= n;
+    r.bytes_float = 0;
+    for(int i = 0; i < layer_n; i++) r.bytes_float += (size_t)layer_sz[i+1] * layer_sz[i] * sizeof(T);
+    r.bytes_quant = size_bytes();
+    return r;
+}
+
+template<typename T>
+double QuantizedFNN<T>::loss(Vec<T> output, Vec<T> expected){
+    double res = 0;
+    for(int i = 0; i < layer_sz[layer_n]; i++){
+        res += (output[i] - expected[i]) * (output[i] - expected[i]);
+    }
+    return res / layer_sz[layer_n];
+}
+
+// ================== Instantiations ==================
+
+template class QuantizedFNN<float>;
+template class QuantizedFNN<double>;
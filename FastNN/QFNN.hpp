@@ -0,0 +1,82 @@
+#ifndef QFNN_HPP
+#define QFNN_HPP
+
+#include <cstdint>
+#include "FNN.hpp"
+
+using namespace std;
+
+// ================== Global Variables ==================
+
+// Rows are padded so the int8 dot product never needs a tail loop
+#define QUANT_ROW_ALIGN 32
+
+// ================== Structures ==================
+
+// Quantized model measured against the model it came from
+struct QuantReport {
+    double loss_float;
+    double loss_quant;
+    double accuracy_float; // share of samples whose largest output matches the expected one
+    double accuracy_quant;
+    double agreement;      // share of samples where both models pick the same output
+    double max_diff;       // largest absolute output difference
+    size_t bytes_float;
+    size_t bytes_quant;
+};
+
+string to_string(const QuantReport& r);
+
+// ================== Quantized Neural Network Class ==================
+
+// Read-only int8 copy of a trained FNN, only supports forward
+// Weights get one scale per row, layer inputs one scale per layer taken from calibration data
+// The bias column of layer 0 is left out of both, see bias
+// Instantiated for float and double in QFNN.cpp
+template<typename T>
+class QuantizedFNN {
+public:
+// Structure
+int layer_n;
+int* layer_sz;   // own copy, bias included in layer_sz[0]
+int* row_stride; // padded row length of each weight layer
+int act_type;
+
+typename ActKernels<T>::Act act_layer;
+
+// Quantized weights, one slab for every layer
+int8_t* arena;
+size_t arena_sz;
+int8_t** qweights;   // qweights[i] is layer i, row-major with row_stride[i]
+int8_t** qinput;     // quantized input of each layer, padded with zeros
+
+// Scales
+T* in_scale;         // in_scale[i] maps qinput[i] back to real values
+T** row_scale;       // weight row scale times the input scale of that layer
+
+// Layer 0's bias weights stay in T and are added after the int8 dot product, quantized with the
+// input scale the bias would round to nothing once the inputs span a wide range
+T* bias;
+
+// Forward data
+Vec<T>* beforeActivation;
+Vec<T>* afterActivation;
+
+    // Setup
+    QuantizedFNN(FNN<T>& nn, Data_Entry<T>* calibration, int n);
+    QuantizedFNN(const QuantizedFNN&) = delete;
+    QuantizedFNN& operator=(const QuantizedFNN&) = delete;
+    ~QuantizedFNN();
+
+    // Neural Network Functions
+    Vec<T> forward(Vec<T> input);
+
+    // Accuracy and size against the float model
+    QuantReport compare(FNN<T>& nn, Data_Entry<T>* dataset, int n);
+    size_t size_bytes();
+
+    // Loss
+    double loss(Vec<T> output, Vec<T> expected);
+};
+
+#endif
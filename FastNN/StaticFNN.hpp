@@ -0,0 +1,206 @@
+#ifndef STATIC_FNN_HPP
+#define STATIC_FNN_HPP
+
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include "FNN.hpp"
+
+using namespace std;
+
+// FNN with the topology fixed at compile time, StaticFNN<2, 20, 20, 2> matches
+// FNN(3, {2, 20, 20, 2}, ...). Every loop bound is a constant and all storage
+// lives inside the object, nothing touches the heap. Needs C++17.
+
+// ================== Layout ==================
+
+// Size of layer l with the bias already added to the input layer
+template<int... Sizes>
+constexpr int static_layer_sz(int l){
+    constexpr int sz[] = {Sizes...};
+    return l == 0 ? sz[0] + 1 : sz[l];
+}
+
+// Start of layer l in the flat weight array
+template<int... Sizes>
+constexpr int static_weight_offset(int l){
+    int res = 0;
+    for(int i = 0; i < l; i++) res += static_layer_sz<Sizes...>(i+1) * static_layer_sz<Sizes...>(i);
+    return res;
+}
+
+// Start of layer l in the flat neuron arrays
+template<int... Sizes>
+constexpr int static_neuron_offset(int l){
+    int res = 0;
+    for(int i = 0; i < l; i++) res += static_layer_sz<Sizes...>(i+1);
+    return res;
+}
+
+// ================== Static Neural Network Class ==================
+
+template<typename T, int... Sizes>
+class BasicStaticFNN {
+public:
+// Structure
+static constexpr int layer_n = sizeof...(Sizes) - 1;
+static constexpr int weight_n = static_weight_offset<Sizes...>(layer_n);
+static constexpr int neuron_n = static_neuron_offset<Sizes...>(layer_n);
+int act_type;
+double lr;
+long long epoch;    // epochs trained so far, the lr decay counts from it like FNN's
+
+typename ActKernels<T>::Act act_layer;
+typename ActKernels<T>::ActD act_d_layer;
+
+// Network weights, layer i is row-major layer_sz(i+1) x layer_sz(i)
+alignas(ARENA_ALIGN) array<T, weight_n> weights;
+
+// Forward data
+alignas(ARENA_ALIGN) array<T, static_layer_sz<Sizes...>(0)> input; // bias included
+alignas(ARENA_ALIGN) array<T, neuron_n> beforeActivation;
+alignas(ARENA_ALIGN) array<T, neuron_n> afterActivation;
+// Gradient data
+alignas(ARENA_ALIGN) array<T, neuron_n> delta;
+
+    static constexpr int layer_sz(int l){ return static_layer_sz<Sizes...>(l); }
+
+    // Setup
+    BasicStaticFNN(int activation, double lr){
+        this->act_type = activation;
+        this->lr = lr;
+        this->epoch = 0;
+        const ActKernels<T>& kernels = act_kernels<T>();
+        act_layer = act_type == _relu ? kernels.relu : kernels.sigmoid;
+        act_d_layer = act_type == _relu ? kernels.relu_d : kernels.sigmoid_d;
+
+        // Same order of rand() calls as FNN::init, so both start from the same weights
+        for(int i = 0; i < weight_n; i++){
+            weights[i] = (rand() % 100) / 100.0;
+        }
+    }
+
+    T& weight(int i, int j, int k){
+        return weights[static_weight_offset<Sizes...>(i) + j * layer_sz(i) + k];
+    }
+
+    // Neural Network Functions
+    Vec<T> forward(const T* in){
+        for(int k = 0; k < layer_sz(0)-1; k++) input[k] = in[k];
+        input[layer_sz(0)-1] = 1;
+        forward_layers(make_index_sequence<layer_n>{});
+        return afterActivation.data() + static_neuron_offset<Sizes...>(layer_n-1);
+    }
+
+    void backward(const T* in, const T* result, double lr){
+        Vec<T> output = forward(in);
+
+        // Update deltas
+        constexpr int last = static_neuron_offset<Sizes...>(layer_n-1);
+        for(int j = 0; j < layer_sz(layer_n); j++){
+            delta[last + j] = result[j] - output[j];
+        }
+        act_d_layer(&beforeActivation[last], &afterActivation[last], &delta[last], layer_sz(layer_n));
+        delta_layers(make_index_sequence<layer_n-1>{});
+
+        // Update weights
+        update_layers((T)lr, make_index_sequence<layer_n>{});
+    }
+
+    void train(Data_Entry<T>* dataset, int n, int epochs, double& lr){
+        for(int e = 0; e < epochs; e++){
+            for(int i = 0; i < n; i++){
+                backward(dataset[i].first, dataset[i].second, lr);
+            }
+            if(epoch % 50 == 0) lr *= 0.99;
+            epoch++;
+            this->lr = lr;
+        }
+    }
+
+    // Loss
+    double loss(Vec<T> output, Vec<T> expected){
+        double res = 0;
+        for(int i = 0; i < layer_sz(layer_n); i++){
+            res += (output[i] - expected[i]) * (output[i] - expected[i]);
+        }
+        return res / layer_sz(layer_n);
+    }
+
+private:
+    // Input of layer L, the bias-extended input or the previous activations
+    template<int L>
+    const T* layer_input(){
+        if constexpr(L == 0) return input.data();
+        else return afterActivation.data() + static_neuron_offset<Sizes...>(L-1);
+    }
+
+    template<int L>
+    void forward_layer(){
+        constexpr int in = layer_sz(L), out = layer_sz(L+1);
+        constexpr int w0 = static_weight_offset<Sizes...>(L), n0 = static_neuron_offset<Sizes...>(L);
+        const T* x = layer_input<L>();
+        for(int j = 0; j < out; j++){
+            const T* w = &weights[w0 + j * in];
+            T sum = 0;
+            for(int k = 0; k < in; k++){
+                sum += w[k] * x[k];
+            }
+            beforeActivation[n0 + j] = sum;
+        }
+        act_layer(&beforeActivation[n0], &afterActivation[n0], out);
+    }
+
+    // Delta of layer L from the delta of layer L+1
+    template<int L>
+    void delta_layer(){
+        constexpr int sz = layer_sz(L+1), next = layer_sz(L+2);
+        constexpr int w0 = static_weight_offset<Sizes...>(L+1);
+        constexpr int n0 = static_neuron_offset<Sizes...>(L), n1 = static_neuron_offset<Sizes...>(L+1);
+        for(int j = 0; j < sz; j++){
+            T sum = 0;
+            for(int k = 0; k < next; k++){
+                sum += delta[n1 + k] * weights[w0 + k * sz + j];
+            }
+            delta[n0 + j] = sum;
+        }
+        act_d_layer(&beforeActivation[n0], &afterActivation[n0], &delta[n0], sz);
+    }
+
+    template<int L>
+    void update_layer(T lr){
+        constexpr int in = layer_sz(L), out = layer_sz(L+1);
+        constexpr int w0 = static_weight_offset<Sizes...>(L), n0 = static_neuron_offset<Sizes...>(L);
+        const T* prev = layer_input<L>();
+        for(int j = 0; j < out; j++){
+            T* w = &weights[w0 + j * in];
+            T d = lr * delta[n0 + j];
+            for(int k = 0; k < in; k++){
+                w[k] += d * prev[k];
+            }
+        }
+    }
+
+    template<size_t... L>
+    void forward_layers(index_sequence<L...>){
+        (forward_layer<L>(), ...);
+    }
+
+    // Runs from the second to last layer down to the first
+    template<size_t... L>
+    void delta_layers(index_sequence<L...>){
+        (delta_layer<layer_n - 2 - (int)L>(), ...);
+    }
+
+    template<size_t... L>
+    void update_layers(T lr, index_sequence<L...>){
+        (update_layer<L>(lr), ...);
+    }
+};
+
+// Double precision, the same default as the display
+template<int... Sizes>
+using StaticFNN = BasicStaticFNN<double, Sizes...>;
+
+#endif
@@ -0,0 +1,474 @@
+#include "kernels.hpp"
+#include <cmath>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// ================== Exponent ==================
+
+// exp(x) = 2^n * exp(r), n = round(x / ln2), |r| <= ln2 / 2
+// exp(r) is a Taylor polynomial, degree 12 for double and 7 for float,
+// close to 1 ulp on that range
+// x is clamped to [EXP_LO, EXP_HI] first, so sigmoid saturates at 1 / (1 + exp(EXP_HI)) instead of reaching 0.
+// min/max return their second operand when one is NaN, x goes second so a NaN comes out as NaN
+#define EXP_HI 708.0
+#define EXP_LO -708.0
+#define EXP_LOG2E 1.4426950408889634
+#define EXP_LN2_HI 6.93145751953125e-1
+#define EXP_LN2_LO 1.42860682030941723212e-6
+// Adding 1.5 * 2^52 rounds to an integer and leaves it in the low mantissa bits
+#define EXP_MAGIC 6755399441055744.0
+#define EXP_MAGIC_BITS 0x4338000000000000LL
+
+static const double exp_coef[13] = {
+    1.0 / 479001600, 1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880,
+    1.0 / 40320, 1.0 / 5040, 1.0 / 720, 1.0 / 120,
+    1.0 / 24, 1.0 / 6, 1.0 / 2, 1.0, 1.0
+};
+
+#define EXPF_HI 87.0f
+#define EXPF_LO -87.0f
+#define EXPF_LOG2E 1.44269504f
+#define EXPF_LN2_HI 0.693359375f
+#define EXPF_LN2_LO -2.12194440e-4f
+// 1.5 * 2^23, the float version of the rounding trick
+#define EXPF_MAGIC 12582912.0f
+#define EXPF_MAGIC_BITS 0x4B400000
+
+static const float expf_coef[8] = {
+    1.0f / 5040, 1.0f / 720, 1.0f / 120, 1.0f / 24,
+    1.0f / 6, 1.0f / 2, 1.0f, 1.0f
+};
+
+// ================== Scalar ==================
+
+template<typename T>
+static void sigmoid_scalar(const T* x, T* y, int n){
+    for(int i = 0; i < n; i++) y[i] = 1 / (1 + exp(-x[i]));
+}
+
+template<typename T>
+static void sigmoid_d_scalar(const T* x, const T* y, T* g, int n){
+    for(int i = 0; i < n; i++) g[i] *= y[i] * (1 - y[i]);
+}
+
+template<typename T>
+static void relu_scalar(const T* x, T* y, int n){
+    for(int i = 0; i < n; i++) y[i] = x[i] > 0 ? x[i] : 0;
+}
+
+template<typename T>
+static void relu_d_scalar(const T* x, const T* y, T* g, int n){
+    for(int i = 0; i < n; i++) g[i] = x[i] > 0 ? g[i] : 0;
+}
+
+// ================== SSE2 ==================
+
+// The vector kernels and the cpuid probe are x86 only, elsewhere the scalar ones are all there is
+#if defined(__x86_64__) || defined(__i386__)
+
+// Part of x86-64 itself, the target only matters for 32-bit builds
+#define SSE2_TARGET __attribute__((target("sse2")))
+
+SSE2_TARGET static inline __m128d exp_sse2(__m128d x){
+    x = _mm_min_pd(_mm_set1_pd(EXP_HI), _mm_max_pd(_mm_set1_pd(EXP_LO), x));
+    __m128d t = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(EXP_LOG2E)), _mm_set1_pd(EXP_MAGIC));
+    __m128d k = _mm_sub_pd(t, _mm_set1_pd(EXP_MAGIC));
+    __m128d r = _mm_sub_pd(x, _mm_mul_pd(k, _mm_set1_pd(EXP_LN2_HI)));
+    r = _mm_sub_pd(r, _mm_mul_pd(k, _mm_set1_pd(EXP_LN2_LO)));
+
+    __m128d p = _mm_set1_pd(exp_coef[0]);
+    for(int i = 1; i < 13; i++) p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(exp_coef[i]));
+
+    __m128i e = _mm_sub_epi64(_mm_castpd_si128(t), _mm_set1_epi64x(EXP_MAGIC_BITS - 1023));
+    return _mm_mul_pd(p, _mm_castsi128_pd(_mm_slli_epi64(e, 52)));
+}
+
+SSE2_TARGET static void sigmoid_sse2(const double* x, double* y, int n){
+    const __m128d one = _mm_set1_pd(1.0);
+    int i = 0;
+    for(; i + 2 <= n; i += 2){
+        __m128d e = exp_sse2(_mm_sub_pd(_mm_setzero_pd(), _mm_loadu_pd(x + i)));
+        _mm_storeu_pd(y + i, _mm_div_pd(one, _mm_add_pd(one, e)));
+    }
+    sigmoid_scalar(x + i, y + i, n - i);
+}
+
+SSE2_TARGET static void sigmoid_d_sse2(const double* x, const double* y, double* g, int n){
+    const __m128d one = _mm_set1_pd(1.0);
+    int i = 0;
+    for(; i + 2 <= n; i += 2){
+        __m128d v = _mm_loadu_pd(y + i);
+        __m128d d = _mm_mul_pd(v, _mm_sub_pd(one, v));
+        _mm_storeu_pd(g + i, _mm_mul_pd(_mm_loadu_pd(g + i), d));
+    }
+    sigmoid_d_scalar(x + i, y + i, g + i, n - i);
+}
+
+SSE2_TARGET static void relu_sse2(const double* x, double* y, int n){
+    int i = 0;
+    for(; i + 2 <= n; i += 2){
+        _mm_storeu_pd(y + i, _mm_max_pd(_mm_loadu_pd(x + i), _mm_setzero_pd()));
+    }
+    relu_scalar(x + i, y + i, n - i);
+}
+
+SSE2_TARGET static void relu_d_sse2(const double* x, const double* y, double* g, int n){
+    int i = 0;
+    for(; i + 2 <= n; i += 2){
+        __m128d mask = _mm_cmpgt_pd(_mm_loadu_pd(x + i), _mm_setzero_pd());
+        _mm_storeu_pd(g + i, _mm_and_pd(_mm_loadu_pd(g + i), mask));
+    }
+    relu_d_scalar(x + i, y + i, g + i, n - i);
+}
+
+SSE2_TARGET static inline __m128 expf_sse2(__m128 x){
+    x = _mm_min_ps(_mm_set1_ps(EXPF_HI), _mm_max_ps(_mm_set1_ps(EXPF_LO), x));
+    __m128 t = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(EXPF_LOG2E)), _mm_set1_ps(EXPF_MAGIC));
+    __m128 k = _mm_sub_ps(t, _mm_set1_ps(EXPF_MAGIC));
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(EXPF_LN2_HI)));
+    r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(EXPF_LN2_LO)));
+
+    __m128 p = _mm_set1_ps(expf_coef[0]);
+    for(int i = 1; i < 8; i++) p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(expf_coef[i]));
+
+    __m128i e = _mm_sub_epi32(_mm_castps_si128(t), _mm_set1_epi32(EXPF_MAGIC_BITS - 127));
+    return _mm_mul_ps(p, _mm_castsi128_ps(_mm_slli_epi32(e, 23)));
+}
+
+SSE2_TARGET static void sigmoid_sse2(const float* x, float* y, int n){
+    const __m128 one = _mm_set1_ps(1.0f);
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m128 e = expf_sse2(_mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(x + i)));
+        _mm_storeu_ps(y + i, _mm_div_ps(one, _mm_add_ps(one, e)));
+    }
+    sigmoid_scalar(x + i, y + i, n - i);
+}
+
+SSE2_TARGET static void sigmoid_d_sse2(const float* x, const float* y, float* g, int n){
+    const __m128 one = _mm_set1_ps(1.0f);
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m128 v = _mm_loadu_ps(y + i);
+        __m128 d = _mm_mul_ps(v, _mm_sub_ps(one, v));
+        _mm_storeu_ps(g + i, _mm_mul_ps(_mm_loadu_ps(g + i), d));
+    }
+    sigmoid_d_scalar(x + i, y + i, g + i, n - i);
+}
+
+SSE2_TARGET static void relu_sse2(const float* x, float* y, int n){
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        _mm_storeu_ps(y + i, _mm_max_ps(_mm_loadu_ps(x + i), _mm_setzero_ps()));
+    }
+    relu_scalar(x + i, y + i, n - i);
+}
+
+SSE2_TARGET static void relu_d_sse2(const float* x, const float* y, float* g, int n){
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m128 mask = _mm_cmpgt_ps(_mm_loadu_ps(x + i), _mm_setzero_ps());
+        _mm_storeu_ps(g + i, _mm_and_ps(_mm_loadu_ps(g + i), mask));
+    }
+    relu_d_scalar(x + i, y + i, g + i, n - i);
+}
+
+// ================== AVX2 ==================
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+
+AVX2_TARGET static inline __m256d exp_avx2(__m256d x){
+    x = _mm256_min_pd(_mm256_set1_pd(EXP_HI), _mm256_max_pd(_mm256_set1_pd(EXP_LO), x));
+    __m256d t = _mm256_fmadd_pd(x, _mm256_set1_pd(EXP_LOG2E), _mm256_set1_pd(EXP_MAGIC));
+    __m256d k = _mm256_sub_pd(t, _mm256_set1_pd(EXP_MAGIC));
+    __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(EXP_LN2_HI), x);
+    r = _mm256_fnmadd_pd(k, _mm256_set1_pd(EXP_LN2_LO), r);
+
+    __m256d p = _mm256_set1_pd(exp_coef[0]);
+    for(int i = 1; i < 13; i++) p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_coef[i]));
+
+    __m256i e = _mm256_sub_epi64(_mm256_castpd_si256(t), _mm256_set1_epi64x(EXP_MAGIC_BITS - 1023));
+    return _mm256_mul_pd(p, _mm256_castsi256_pd(_mm256_slli_epi64(e, 52)));
+}
+
+AVX2_TARGET static void sigmoid_avx2(const double* x, double* y, int n){
+    const __m256d one = _mm256_set1_pd(1.0);
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256d e = exp_avx2(_mm256_sub_pd(_mm256_setzero_pd(), _mm256_loadu_pd(x + i)));
+        _mm256_storeu_pd(y + i, _mm256_div_pd(one, _mm256_add_pd(one, e)));
+    }
+    sigmoid_sse2(x + i, y + i, n - i);
+}
+
+AVX2_TARGET static void sigmoid_d_avx2(const double* x, const double* y, double* g, int n){
+    const __m256d one = _mm256_set1_pd(1.0);
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256d v = _mm256_loadu_pd(y + i);
+        __m256d d = _mm256_mul_pd(v, _mm256_sub_pd(one, v));
+        _mm256_storeu_pd(g + i, _mm256_mul_pd(_mm256_loadu_pd(g + i), d));
+    }
+    sigmoid_d_sse2(x + i, y + i, g + i, n - i);
+}
+
+AVX2_TARGET static void relu_avx2(const double* x, double* y, int n){
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        _mm256_storeu_pd(y + i, _mm256_max_pd(_mm256_loadu_pd(x + i), _mm256_setzero_pd()));
+    }
+    relu_sse2(x + i, y + i, n - i);
+}
+
+AVX2_TARGET static void relu_d_avx2(const double* x, const double* y, double* g, int n){
+    int i = 0;
+    for(; i + 4 <= n; i += 4){
+        __m256d mask = _mm256_cmp_pd(_mm256_loadu_pd(x + i), _mm256_setzero_pd(), _CMP_GT_OQ);
+        _mm256_storeu_pd(g + i, _mm256_and_pd(_mm256_loadu_pd(g + i), mask));
+    }
+    relu_d_sse2(x + i, y + i, g + i, n - i);
+}
+
+AVX2_TARGET static inline __m256 expf_avx2(__m256 x){
+    x = _mm256_min_ps(_mm256_set1_ps(EXPF_HI), _mm256_max_ps(_mm256_set1_ps(EXPF_LO), x));
+    __m256 t = _mm256_fmadd_ps(x, _mm256_set1_ps(EXPF_LOG2E), _mm256_set1_ps(EXPF_MAGIC));
+    __m256 k = _mm256_sub_ps(t, _mm256_set1_ps(EXPF_MAGIC));
+    __m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(EXPF_LN2_HI), x);
+    r = _mm256_fnmadd_ps(k, _mm256_set1_ps(EXPF_LN2_LO), r);
+
+    __m256 p = _mm256_set1_ps(expf_coef[0]);
+    for(int i = 1; i < 8; i++) p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(expf_coef[i]));
+
+    __m256i e = _mm256_sub_epi32(_mm256_castps_si256(t), _mm256_set1_epi32(EXPF_MAGIC_BITS - 127));
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(e, 23)));
+}
+
+AVX2_TARGET static void sigmoid_avx2(const float* x, float* y, int n){
+    const __m256 one = _mm256_set1_ps(1.0f);
+    int i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m256 e = expf_avx2(_mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(x + i)));
+        _mm256_storeu_ps(y + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+    }
+    sigmoid_sse2(x + i, y + i, n - i);
+}
+
+AVX2_TARGET static void sigmoid_d_avx2(const float* x, const float* y, float* g, int n){
+    const __m256 one = _mm256_set1_ps(1.0f);
+    int i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m256 v = _mm256_loadu_ps(y + i);
+        __m256 d = _mm256_mul_ps(v, _mm256_sub_ps(one, v));
+        _mm256_storeu_ps(g + i, _mm256_mul_ps(_mm256_loadu_ps(g + i), d));
+    }
+    sigmoid_d_sse2(x + i, y + i, g + i, n - i);
+}
+
+AVX2_TARGET static void relu_avx2(const float* x, float* y, int n){
+    int i = 0;
+    for(; i + 8 <= n; i += 8){
+        _mm256_storeu_ps(y + i, _mm256_max_ps(_mm256_loadu_ps(x + i), _mm256_setzero_ps()));
+    }
+    relu_sse2(x + i, y + i, n - i);
+}
+
+AVX2_TARGET static void relu_d_avx2(const float* x, const float* y, float* g, int n){
+    int i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m256 mask = _mm256_cmp_ps(_mm256_loadu_ps(x + i), _mm256_setzero_ps(), _CMP_GT_OQ);
+        _mm256_storeu_ps(g + i, _mm256_and_ps(_mm256_loadu_ps(g + i), mask));
+    }
+    relu_d_sse2(x + i, y + i, g + i, n - i);
+}
+
+// ================== AVX-512 ==================
+
+#define AVX512_TARGET __attribute__((target("avx512f")))
+
+// GCC 12's avx512 headers trip -Wmaybe-uninitialized on their own placeholders
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+AVX512_TARGET static inline __m512d exp_avx512(__m512d x){
+    x = _mm512_min_pd(_mm512_set1_pd(EXP_HI), _mm512_max_pd(_mm512_set1_pd(EXP_LO), x));
+    __m512d t = _mm512_fmadd_pd(x, _mm512_set1_pd(EXP_LOG2E), _mm512_set1_pd(EXP_MAGIC));
+    __m512d k = _mm512_sub_pd(t, _mm512_set1_pd(EXP_MAGIC));
+    __m512d r = _mm512_fnmadd_pd(k, _mm512_set1_pd(EXP_LN2_HI), x);
+    r = _mm512_fnmadd_pd(k, _mm512_set1_pd(EXP_LN2_LO), r);
+
+    __m512d p = _mm512_set1_pd(exp_coef[0]);
+    for(int i = 1; i < 13; i++) p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(exp_coef[i]));
+
+    __m512i e = _mm512_sub_epi64(_mm512_castpd_si512(t), _mm512_set1_epi64(EXP_MAGIC_BITS - 1023));
+    return _mm512_mul_pd(p, _mm512_castsi512_pd(_mm512_slli_epi64(e, 52)));
+}
+
+AVX512_TARGET static void sigmoid_avx512(const double* x, double* y, int n){
+    const __m512d one = _mm512_set1_pd(1.0);
+    int i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m512d e = exp_avx512(_mm512_sub_pd(_mm512_setzero_pd(), _mm512_loadu_pd(x + i)));
+        _mm512_storeu_pd(y + i, _mm512_div_pd(one, _mm512_add_pd(one, e)));
+    }
+    // Tail is masked instead of falling back to narrower kernels
+    if(i < n){
+        __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+        __m512d e = exp_avx512(_mm512_sub_pd(_mm512_setzero_pd(), _mm512_maskz_loadu_pd(m, x + i)));
+        _mm512_mask_storeu_pd(y + i, m, _mm512_div_pd(one, _mm512_add_pd(one, e)));
+    }
+}
+
+AVX512_TARGET static void sigmoid_d_avx512(const double* x, const double* y, double* g, int n){
+    const __m512d one = _mm512_set1_pd(1.0);
+    int i = 0;
+    for(; i + 8 <= n; i += 8){
+        __m512d v = _mm512_loadu_pd(y + i);
+        __m512d d = _mm512_mul_pd(v, _mm512_sub_pd(one, v));
+        _mm512_storeu_pd(g + i, _mm512_mul_pd(_mm512_loadu_pd(g + i), d));
+    }
+    if(i < n){
+        __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+        __m512d v = _mm512_maskz_loadu_pd(m, y + i);
+        __m512d d = _mm512_mul_pd(v, _mm512_sub_pd(one, v));
+        _mm512_mask_storeu_pd(g + i, m, _mm512_mul_pd(_mm512_maskz_loadu_pd(m, g + i), d));
+    }
+}
+
+AVX512_TARGET static void relu_avx512(const double* x, double* y, int n){
+    int i = 0;
+    for(; i + 8 <= n; i += 8){
+        _mm512_storeu_pd(y + i, _mm512_max_pd(_mm512_loadu_pd(x + i), _mm512_setzero_pd()));
+    }
+    if(i < n){
+        __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+        _mm512_mask_storeu_pd(y + i, m, _mm512_max_pd(_mm512_maskz_loadu_pd(m, x + i), _mm512_setzero_pd()));
+    }
+}
+
+AVX512_TARGET static void relu_d_avx512(const double* x, const double* y, double* g, int n){
+    int i = 0;
+    for(; i + 8 <= n; i += 8){
+        __mmask8 pos = _mm512_cmp_pd_mask(_mm512_loadu_pd(x + i), _mm512_setzero_pd(), _CMP_GT_OQ);
+        _mm512_storeu_pd(g + i, _mm512_maskz_mov_pd(pos, _mm512_loadu_pd(g + i)));
+    }
+    if(i < n){
+        __mmask8 m = (__mmask8)((1u << (n - i)) - 1);
+        __mmask8 pos = _mm512_mask_cmp_pd_mask(m, _mm512_maskz_loadu_pd(m, x + i), _mm512_setzero_pd(), _CMP_GT_OQ);
+        _mm512_mask_storeu_pd(g + i, m, _mm512_maskz_mov_pd(pos, _mm512_maskz_loadu_pd(m, g + i)));
+    }
+}
+
+AVX512_TARGET static inline __m512 expf_avx512(__m512 x){
+    x = _mm512_min_ps(_mm512_set1_ps(EXPF_HI), _mm512_max_ps(_mm512_set1_ps(EXPF_LO), x));
+    __m512 t = _mm512_fmadd_ps(x, _mm512_set1_ps(EXPF_LOG2E), _mm512_set1_ps(EXPF_MAGIC));
+    __m512 k = _mm512_sub_ps(t, _mm512_set1_ps(EXPF_MAGIC));
+    __m512 r = _mm512_fnmadd_ps(k, _mm512_set1_ps(EXPF_LN2_HI), x);
+    r = _mm512_fnmadd_ps(k, _mm512_set1_ps(EXPF_LN2_LO), r);
+
+    __m512 p = _mm512_set1_ps(expf_coef[0]);
+    for(int i = 1; i < 8; i++) p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(expf_coef[i]));
+
+    __m512i e = _mm512_sub_epi32(_mm512_castps_si512(t), _mm512_set1_epi32(EXPF_MAGIC_BITS - 127));
+    return _mm512_mul_ps(p, _mm512_castsi512_ps(_mm512_slli_epi32(e, 23)));
+}
+
+AVX512_TARGET static void sigmoid_avx512(const float* x, float* y, int n){
+    const __m512 one = _mm512_set1_ps(1.0f);
+    int i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m512 e = expf_avx512(_mm512_sub_ps(_mm512_setzero_ps(), _mm512_loadu_ps(x + i)));
+        _mm512_storeu_ps(y + i, _mm512_div_ps(one, _mm512_add_ps(one, e)));
+    }
+    if(i < n){
+        __mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+        __m512 e = expf_avx512(_mm512_sub_ps(_mm512_setzero_ps(), _mm512_maskz_loadu_ps(m, x + i)));
+        _mm512_mask_storeu_ps(y + i, m, _mm512_div_ps(one, _mm512_add_ps(one, e)));
+    }
+}
+
+AVX512_TARGET static void sigmoid_d_avx512(const float* x, const float* y, float* g, int n){
+    const __m512 one = _mm512_set1_ps(1.0f);
+    int i = 0;
+    for(; i + 16 <= n; i += 16){
+        __m512 v = _mm512_loadu_ps(y + i);
+        __m512 d = _mm512_mul_ps(v, _mm512_sub_ps(one, v));
+        _mm512_storeu_ps(g + i, _mm512_mul_ps(_mm512_loadu_ps(g + i), d));
+    }
+    if(i < n){
+        __mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+        __m512 v = _mm512_maskz_loadu_ps(m, y + i);
+        __m512 d = _mm512_mul_ps(v, _mm512_sub_ps(one, v));
+        _mm512_mask_storeu_ps(g + i, m, _mm512_mul_ps(_mm512_maskz_loadu_ps(m, g + i), d));
+    }
+}
+
+AVX512_TARGET static void relu_avx512(const float* x, float* y, int n){
+    int i = 0;
+    for(; i + 16 <= n; i += 16){
+        _mm512_storeu_ps(y + i, _mm512_max_ps(_mm512_loadu_ps(x + i), _mm512_setzero_ps()));
+    }
+    if(i < n){
+        __mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+        _mm512_mask_storeu_ps(y + i, m, _mm512_max_ps(_mm512_maskz_loadu_ps(m, x + i), _mm512_setzero_ps()));
+    }
+}
+
+AVX512_TARGET static void relu_d_avx512(const float* x, const float* y, float* g, int n){
+    int i = 0;
+    for(; i + 16 <= n; i += 16){
+        __mmask16 pos = _mm512_cmp_ps_mask(_mm512_loadu_ps(x + i), _mm512_setzero_ps(), _CMP_GT_OQ);
+        _mm512_storeu_ps(g + i, _mm512_maskz_mov_ps(pos, _mm512_loadu_ps(g + i)));
+    }
+    if(i < n){
+        __mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+        __mmask16 pos = _mm512_mask_cmp_ps_mask(m, _mm512_maskz_loadu_ps(m, x + i), _mm512_setzero_ps(), _CMP_GT_OQ);
+        _mm512_mask_storeu_ps(g + i, m, _mm512_maskz_mov_ps(pos, _mm512_maskz_loadu_ps(m, g + i)));
+    }
+}
+
+#pragma GCC diagnostic pop
+
+#endif
+
+// ================== Dispatch ==================
+
+static int detect_isa(){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return ISA_AVX512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return ISA_AVX2;
+    if(__builtin_cpu_supports("sse2")) return ISA_SSE2;
+#endif
+    return ISA_SCALAR;
+}
+
+int cpu_isa(){
+    static const int isa = detect_isa();
+    return isa;
+}
+
+// The kernel names are overloaded on element type, so both tables read the same
+template<typename T>
+static ActKernels<T> kernel_table(int isa){
+    if(isa > cpu_isa()) isa = cpu_isa();
+#if defined(__x86_64__) || defined(__i386__)
+    if(isa == ISA_AVX512) return {ISA_AVX512, "avx512", sigmoid_avx512, sigmoid_d_avx512, relu_avx512, relu_d_avx512};
+    if(isa == ISA_AVX2)   return {ISA_AVX2, "avx2", sigmoid_avx2, sigmoid_d_avx2, relu_avx2, relu_d_avx2};
+    if(isa == ISA_SSE2)   return {ISA_SSE2, "sse2", sigmoid_sse2, sigmoid_d_sse2, relu_sse2, relu_d_sse2};
+#endif
+    return {ISA_SCALAR, "scalar", sigmoid_scalar<T>, sigmoid_d_scalar<T>, relu_scalar<T>, relu_d_scalar<T>};
+}
+
+template<>
+ActKernels<float> act_kernels<float>(int isa){
+    return kernel_table<float>(isa);
+}
+
+template<>
+ActKernels<double> act_kernels<double>(int isa){
+    return kernel_table<double>(isa);
+}
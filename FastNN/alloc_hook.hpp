@@ -0,0 +1,39 @@
+#ifndef ALLOC_HOOK_HPP
+#define ALLOC_HOOK_HPP
+
+#include <cstdlib>
+#include <new>
+#include "memory.hpp"
+
+// Replaces the global operator new/delete with versions that bump alloc_counter()
+// Include it in exactly one source file of a program, then compare alloc_count()
+// around the code that must not allocate
+
+void* operator new(size_t n){
+    alloc_counter()++;
+    void* p = malloc(n ? n : 1);
+    if(p == nullptr) throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t n){
+    return operator new(n);
+}
+
+void operator delete(void* p) noexcept{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept{
+    free(p);
+}
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include "FNN.hpp"
+#include "memory.hpp"
+
+using namespace std;
+
+// Background checkpoints for long training runs
+// The training thread only copies the weights into one of two buffers, a writer thread
+// checksums, writes and fsyncs it while training goes on. Resume with FNN<T>::load_mmap(path)
+
+// ================== Global Variables ==================
+
+// Buffer states
+#define CKPT_FREE 0
+#define CKPT_FILLING 1
+#define CKPT_PENDING 2
+#define CKPT_WRITING 3
+
+// ================== Checkpointer ==================
+
+template<typename T>
+class Checkpointer {
+public:
+FNN<T>* nn;          // follows the model when it is moved, null once it is destroyed
+vector<int> layer_sz; // copied up front, so the writer never reads the model
+string path;
+int every_epochs;      // 0 turns the epoch trigger off
+double every_seconds;  // 0 turns the time trigger off
+
+// Double buffer, the writer owns at most one of them, so the trainer always has the other
+T* buffers[2];
+ModelHeader headers[2];
+int state[2];
+long long last_epoch;
+chrono::steady_clock::time_point last_time;
+
+thread writer;
+mutex mtx;
+condition_variable cv;
+bool stop;
+
+// Stats, read them after flush()
+long long requested;   // snapshots taken
+long long written;     // snapshots on disk, a pending snapshot replaced by a newer one is never written
+long long failed;
+double stall_ns;       // time the training thread spent in checkpoint(), in total
+double max_stall_ns;
+
+    // Attaches to nn, which then calls maybe_checkpoint() after every epoch
+    Checkpointer(FNN<T>& nn, const string& path, int every_epochs, double every_seconds) : nn(&nn), layer_sz(nn.layer_sz, nn.layer_sz + nn.layer_n + 1), path(path) {
+        this->every_epochs = every_epochs;
+        this->every_seconds = every_seconds;
+        size_t n = nn.model_size() / sizeof(T);
+        for(int b = 0; b < 2; b++){
+            buffers[b] = aligned_new<T>(n, ARENA_ALIGN);
+            state[b] = CKPT_FREE;
+        }
+        last_epoch = nn.epoch;
+        last_time = chrono::steady_clock::now();
+        stop = false;
+        requested = written = failed = 0;
+        stall_ns = max_stall_ns = 0;
+
+        writer = thread([this]{ writer_loop(); });
+        nn.checkpointer = this;
+    }
+
+    // Writes out whatever is pending before returning
+    ~Checkpointer(){
+        if(nn != nullptr && nn->checkpointer == this) nn->checkpointer = nullptr;
+        {
+            lock_guard<mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        writer.join();
+        for(int b = 0; b < 2; b++) aligned_delete(buffers[b]);
+    }
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    bool due(){
+        if(every_epochs > 0 && nn->epoch - last_epoch >= every_epochs) return true;
+        if(every_seconds > 0){
+            double elapsed = chrono::duration<double>(chrono::steady_clock::now() - last_time).count();
+            if(elapsed >= every_seconds) return true;
+        }
+        return false;
+    }
+
+    void maybe_checkpoint(){
+        if(due()) checkpoint();
+    }
+
+    // Snapshot now, costs one copy of the weights on the calling thread
+    void checkpoint(){
+        if(nn == nullptr) throw runtime_error("Checkpointer has no model, it was destroyed");
+        auto startTime = chrono::steady_clock::now();
+
+        // A pending snapshot the writer has not started on gets replaced, otherwise take the free buffer
+        int b;
+        {
+            lock_guard<mutex> lock(mtx);
+            b = state[0] == CKPT_WRITING ? 1 : state[1] == CKPT_WRITING ? 0 : state[0] == CKPT_PENDING ? 0 : state[1] == CKPT_PENDING ? 1 : 0;
+            state[b] = CKPT_FILLING;
+        }
+        nn->snapshot(buffers[b]);
+        headers[b] = nn->model_header();
+        {
+            lock_guard<mutex> lock(mtx);
+            state[b] = CKPT_PENDING;
+        }
+        cv.notify_all();
+
+        last_epoch = nn->epoch;
+        last_time = chrono::steady_clock::now();
+        requested++;
+        double ns = chrono::duration<double, nano>(last_time - startTime).count();
+        stall_ns += ns;
+        if(ns > max_stall_ns) max_stall_ns = ns;
+    }
+
+    // Blocks until nothing is pending or being written
+    void flush(){
+        unique_lock<mutex> lock(mtx);
+        cv.wait(lock, [this]{ return state[0] != CKPT_PENDING && state[0] != CKPT_WRITING && state[1] != CKPT_PENDING && state[1] != CKPT_WRITING; });
+    }
+
+    void writer_loop(){
+        unique_lock<mutex> lock(mtx);
+        while(true){
+            cv.wait(lock, [this]{ return stop || state[0] == CKPT_PENDING || state[1] == CKPT_PENDING; });
+            int b = state[0] == CKPT_PENDING ? 0 : state[1] == CKPT_PENDING ? 1 : -1;
+            if(b < 0) return; // stopping with nothing left to write
+
+            // Only one buffer is ever pending, the trainer refills it rather than taking the other one
+            state[b] = CKPT_WRITING;
+            lock.unlock();
+            bool ok = true;
+            try{
+                FNN<T>::write_model(path, headers[b], layer_sz.data(), buffers[b]);
+            }catch(const runtime_error& e){
+                cerr << "Checkpoint failed: " << e.what() << endl;
+                ok = false;
+            }
+            lock.lock();
+            state[b] = CKPT_FREE;
+            if(ok) written++;
+            else failed++;
+            cv.notify_all();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef COST_MODEL_HPP
+#define COST_MODEL_HPP
+
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include "thread_pool.hpp"
+
+using namespace std;
+
+// Decides at run time whether a loop is worth handing to the thread pool
+// Both sides of the trade are measured once at startup: how fast this core does a multiply-add
+// and how long an empty parallel_for takes to go around the pool
+
+// ================== Global Variables ==================
+
+#define COST_MARGIN 1.5    // parallel has to be this much faster than serial to be picked
+#define COST_TASKS 4       // chunks per thread, so a slow thread can be helped out
+#define COST_REPEATS 2000  // calls timed when measuring the dispatch overhead
+
+// ================== Cost Model ==================
+
+struct LoopPlan {
+bool parallel;
+int grain; // iterations per task
+};
+
+class CostModel {
+public:
+int threads;
+double ns_per_flop;  // serial speed of this core on a dot product
+double dispatch_ns;  // round trip of an empty parallel_for over every thread
+
+    CostModel(){
+        threads = thread_pool().size();
+        ns_per_flop = measure_flop();
+        dispatch_ns = threads > 1 ? measure_dispatch() : 0;
+    }
+
+    static double measure_flop(){
+        const int n = 4096;
+        double a[n], b[n];
+        for(int i = 0; i < n; i++){
+            a[i] = i * 0.5;
+            b[i] = 1.0 / (i + 1);
+        }
+        volatile double sink = 0;
+        int reps = 200;
+        auto startTime = chrono::high_resolution_clock::now();
+        for(int r = 0; r < reps; r++){
+            double sum = 0;
+            for(int i = 0; i < n; i++) sum += a[i] * b[i];
+            sink = sink + sum;
+        }
+        auto endTime = chrono::high_resolution_clock::now();
+        return chrono::duration<double, nano>(endTime - startTime).count() / (2.0 * n * reps);
+    }
+
+    static double measure_dispatch(){
+        ThreadPool& pool = thread_pool();
+        auto empty = [](int i){};
+        for(int r = 0; r < COST_REPEATS / 10; r++) pool.parallel_for(pool.size(), empty);
+        auto startTime = chrono::high_resolution_clock::now();
+        for(int r = 0; r < COST_REPEATS; r++) pool.parallel_for(pool.size(), empty);
+        auto endTime = chrono::high_resolution_clock::now();
+        return chrono::duration<double, nano>(endTime - startTime).count() / COST_REPEATS;
+    }
+
+    // items iterations of flops each, e.g. the rows of a layer times 2 * its width
+    LoopPlan plan(int items, double flops){
+        double serial = items * flops * ns_per_flop;
+        double split = dispatch_ns + serial / threads;
+        if(threads <= 1 || items < 2 || split * COST_MARGIN >= serial) return {false, items};
+
+        // Chunks big enough to hide the cost of a steal, small enough to balance the threads
+        double chunk = max(serial / (threads * COST_TASKS), dispatch_ns);
+        int grain = (int)min((double)items, chunk / (flops * ns_per_flop) + 1);
+        return {true, max(1, grain)};
+    }
+
+    string describe(int items, double flops){
+        LoopPlan p = plan(items, flops);
+        return p.parallel ? "parallel, grain " + to_string(p.grain) : "serial";
+    }
+};
+
+// Measured on first use
+inline CostModel& cost_model(){
+    static CostModel model;
+    return model;
+}
+
+// f(i) for every i in [0, items), on the pool only when the cost model says it pays off
+template<typename F>
+inline void auto_for(int items, double flops, F&& f){
+    LoopPlan p = cost_model().plan(items, flops);
+    if(!p.parallel){
+        for(int i = 0; i < items; i++) f(i);
+        return;
+    }
+    thread_pool().parallel_for(items, f, p.grain);
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef DATASET_HPP
+#define DATASET_HPP
+
+#include <random>
+#include <utility>
+#include "FNN.hpp"
+#include "memory.hpp"
+
+using namespace std;
+
+// Training data as two contiguous matrices instead of a pair of heap arrays per sample
+// Rows never move, shuffling permutes the visiting order, so an epoch walks two aligned blocks
+
+// ================== Dataset ==================
+
+template<typename T>
+class Dataset {
+public:
+int n;
+int in;       // input width, without the bias
+int out;
+T* inputs;    // n x in, row-major
+T* targets;   // n x out, row-major
+int* order;   // visiting order, order[i] is the row of the i-th sample
+mt19937 rng;
+
+    // Rows are left uninitialized, fill them through input(i) and target(i)
+    Dataset(int n, int in, int out, unsigned seed = 0) : n(n), in(in), out(out), rng(seed) {
+        inputs = aligned_new<T>((size_t)n * in, ARENA_ALIGN);
+        targets = aligned_new<T>((size_t)n * out, ARENA_ALIGN);
+        order = aligned_new<int>(n, ARENA_ALIGN);
+        reset_order();
+    }
+
+    // Copies pair-of-pointer samples into one block each
+    Dataset(Data_Entry<T>* entries, int n, int in, int out, unsigned seed = 0) : Dataset(n, in, out, seed) {
+        for(int i = 0; i < n; i++){
+            T* x = input(i);
+            T* y = target(i);
+            for(int k = 0; k < in; k++) x[k] = entries[i].first[k];
+            for(int k = 0; k < out; k++) y[k] = entries[i].second[k];
+        }
+    }
+
+    Dataset(Dataset&& other) : n(other.n), in(other.in), out(other.out), inputs(other.inputs), targets(other.targets), order(other.order), rng(other.rng) {
+        other.inputs = nullptr;
+        other.targets = nullptr;
+        other.order = nullptr;
+        other.n = 0;
+    }
+
+    ~Dataset(){
+        aligned_delete(inputs);
+        aligned_delete(targets);
+        aligned_delete(order);
+    }
+
+    Dataset(const Dataset&) = delete;
+    Dataset& operator=(const Dataset&) = delete;
+
+    // Row i as stored
+    T* input(int i){
+        return inputs + (size_t)i * in;
+    }
+    T* target(int i){
+        return targets + (size_t)i * out;
+    }
+
+    // i-th sample in visiting order
+    T* input_at(int i){
+        return input(order[i]);
+    }
+    T* target_at(int i){
+        return target(order[i]);
+    }
+
+    // Fisher-Yates over the indices, the rows stay where they are
+    void shuffle(){
+        for(int i = n - 1; i > 0; i--){
+            int j = uniform_int_distribution<int>(0, i)(rng);
+            swap(order[i], order[j]);
+        }
+    }
+
+    void reset_order(){
+        for(int i = 0; i < n; i++) order[i] = i;
+    }
+
+    size_t bytes(){
+        return (size_t)n * (in * sizeof(T) + out * sizeof(T) + sizeof(int));
+    }
+};
+
+#endif
@@ -0,0 +1,368 @@
+#ifndef DATASET_FILE_HPP
+#define DATASET_FILE_HPP
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "FNN.hpp"
+#include "dataset.hpp"
+#include "memory.hpp"
+
+using namespace std;
+
+// Datasets too big for memory, kept in a file and streamed through mmap
+// File layout: a DatasetHeader, then all inputs (n x in, row-major), then all targets (n x out),
+// each section starting on a page boundary so readahead and eviction work on whole sections
+
+// ================== Global Variables ==================
+
+#define DATASET_MAGIC "FNNDATA"
+#define DATASET_VERSION 1
+#define DATASET_ALIGN 4096
+#define STREAM_CHUNK 16384 // rows faulted in, read ahead and dropped together
+
+// ================== File Format ==================
+
+struct DatasetHeader {
+char magic[8];
+uint32_t version;
+uint32_t dtype;       // MODEL_FLOAT or MODEL_DOUBLE
+uint32_t in;
+uint32_t out;
+uint64_t n;
+uint64_t inputs_offset;
+uint64_t targets_offset;
+uint64_t file_size;
+};
+
+inline uint64_t dataset_align(uint64_t x){
+    return (x + DATASET_ALIGN - 1) / DATASET_ALIGN * DATASET_ALIGN;
+}
+
+template<typename T>
+DatasetHeader dataset_header(uint64_t n, int in, int out){
+    DatasetHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC));
+    h.version = DATASET_VERSION;
+    h.dtype = sizeof(T) == sizeof(float) ? MODEL_FLOAT : MODEL_DOUBLE;
+    h.in = in;
+    h.out = out;
+    h.n = n;
+    h.inputs_offset = dataset_align(sizeof(DatasetHeader));
+    h.targets_offset = dataset_align(h.inputs_offset + n * in * sizeof(T));
+    h.file_size = h.targets_offset + n * out * sizeof(T);
+    return h;
+}
+
+// ================== Writer ==================
+
+// Rows are added one at a time and written a chunk at a time, so the data never has to fit in memory
+// The file appears under path only after close(), like a saved model
+template<typename T>
+class DatasetWriter {
+public:
+string path;
+string tmp;
+int fd;
+DatasetHeader header;
+uint64_t written;
+int chunk_rows;
+int buffered;
+T* buf_in;
+T* buf_out;
+
+    DatasetWriter(const string& path, uint64_t n, int in, int out, int chunk_rows = STREAM_CHUNK) : path(path), tmp(path + ".tmp") {
+        this->chunk_rows = chunk_rows;
+        header = dataset_header<T>(n, in, out);
+        written = 0;
+        buffered = 0;
+        fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) throw runtime_error("Cannot write dataset file " + tmp);
+        if(ftruncate(fd, header.file_size) != 0){
+            abandon();
+            throw runtime_error("Cannot size dataset file " + tmp);
+        }
+        buf_in = aligned_new<T>((size_t)chunk_rows * in);
+        buf_out = aligned_new<T>((size_t)chunk_rows * out);
+    }
+
+    // Without close() the partial file is removed
+    ~DatasetWriter(){
+        if(fd >= 0) abandon();
+        aligned_delete(buf_in);
+        aligned_delete(buf_out);
+    }
+
+    DatasetWriter(const DatasetWriter&) = delete;
+    DatasetWriter& operator=(const DatasetWriter&) = delete;
+
+    void add(const T* x, const T* y){
+        if(written + buffered >= header.n) throw runtime_error("More rows than declared for " + path);
+        memcpy(buf_in + (size_t)buffered * header.in, x, header.in * sizeof(T));
+        memcpy(buf_out + (size_t)buffered * header.out, y, header.out * sizeof(T));
+        if(++buffered == chunk_rows) flush_rows();
+    }
+
+    void close(){
+        flush_rows();
+        if(written != header.n) throw runtime_error("Fewer rows than declared for " + path);
+        write_all(&header, sizeof(header), 0);
+        if(fsync(fd) != 0 || ::close(fd) != 0){
+            fd = -1;
+            throw runtime_error("Cannot write dataset file " + tmp);
+        }
+        fd = -1;
+        if(rename(tmp.c_str(), path.c_str()) != 0) throw runtime_error("Cannot rename dataset file to " + path);
+    }
+
+    void flush_rows(){
+        if(buffered == 0) return;
+        write_all(buf_in, (size_t)buffered * header.in * sizeof(T), header.inputs_offset + written * header.in * sizeof(T));
+        write_all(buf_out, (size_t)buffered * header.out * sizeof(T), header.targets_offset + written * header.out * sizeof(T));
+        written += buffered;
+        buffered = 0;
+    }
+
+    void write_all(const void* data, size_t sz, uint64_t offset){
+        size_t done = 0;
+        while(done < sz){
+            ssize_t w = pwrite(fd, (const char*)data + done, sz - done, offset + done);
+            if(w < 0) throw runtime_error("Cannot write dataset file " + tmp);
+            done += w;
+        }
+    }
+
+    void abandon(){
+        ::close(fd);
+        unlink(tmp.c_str());
+        fd = -1;
+    }
+};
+
+template<typename T>
+void save_dataset(const string& path, Dataset<T>& data){
+    DatasetWriter<T> writer(path, data.n, data.in, data.out);
+    for(int i = 0; i < data.n; i++){
+        writer.add(data.input(i), data.target(i));
+    }
+    writer.close();
+}
+
+// ================== Stream ==================
+
+// Reads a dataset file front to back, one chunk of rows at a time
+// Entering a chunk faults it in (timed as I/O), asks the kernel to read the next one ahead
+// and drops the pages of the previous one, so memory use stays at a few chunks whatever the file size
+// With a shuffle buffer every sample is drawn at random from the last buffer_rows rows read,
+// without one the rows come straight out of the mapping in file order
+template<typename T>
+class DatasetStream {
+public:
+string path;
+void* map;
+size_t map_sz;
+DatasetHeader header;
+long long n;
+int in;
+int out;
+const T* inputs;   // inside the mapping
+const T* targets;
+
+// Cursor
+int chunk_rows;
+long long next_row;
+long long chunk_begin;
+long long chunk_end;
+
+// Shuffle buffer
+int buffer_rows;
+int buffered;
+T* buf_in;
+T* buf_out;
+T* row_in;   // the sample handed out last
+T* row_out;
+mt19937 rng;
+
+// Stats since the last reset_stats()
+long long samples;
+double bytes_read;
+double io_ns;
+chrono::steady_clock::time_point started;
+
+    DatasetStream(const string& path, int buffer_rows = 0, unsigned seed = 0, int chunk_rows = STREAM_CHUNK) : path(path), rng(seed) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) throw runtime_error("Cannot open dataset file " + path);
+        struct stat st;
+        if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(DatasetHeader)){
+            ::close(fd);
+            throw runtime_error("Dataset file too small: " + path);
+        }
+        map_sz = st.st_size;
+        map = mmap(nullptr, map_sz, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(map == MAP_FAILED) throw runtime_error("Cannot map dataset file " + path);
+
+        // The sizes are bounded against the mapping before the offsets are recomputed from them, so a forged
+        // n or width cannot wrap around to offsets that match a small file
+        memcpy(&header, map, sizeof(header));
+        string error;
+        uint64_t in_bytes, out_bytes;
+        if(memcmp(header.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC)) != 0) error = "not a dataset file";
+        else if(header.version != DATASET_VERSION) error = "unsupported version " + to_string(header.version);
+        else if(header.in < 1 || header.in > (uint32_t)INT_MAX || header.out < 1 || header.out > (uint32_t)INT_MAX) error = "bad width";
+        else if(__builtin_mul_overflow(header.n, (uint64_t)header.in * sizeof(T), &in_bytes) || in_bytes > map_sz
+                || __builtin_mul_overflow(header.n, (uint64_t)header.out * sizeof(T), &out_bytes) || out_bytes > map_sz) error = "truncated";
+        if(error.empty()){
+            DatasetHeader expected = dataset_header<T>(header.n, header.in, header.out);
+            if(header.dtype != expected.dtype) error = "scalar type does not match";
+            else if(header.inputs_offset != expected.inputs_offset || header.targets_offset != expected.targets_offset) error = "bad header";
+            else if(header.file_size != expected.file_size || map_sz < header.file_size) error = "truncated";
+        }
+        if(!error.empty()){
+            munmap(map, map_sz);
+            throw runtime_error("Bad dataset file " + path + ": " + error);
+        }
+        madvise(map, map_sz, MADV_SEQUENTIAL);
+
+        n = header.n;
+        in = header.in;
+        out = header.out;
+        inputs = (const T*)((const char*)map + header.inputs_offset);
+        targets = (const T*)((const char*)map + header.targets_offset);
+        this->chunk_rows = max(1, chunk_rows);
+        this->buffer_rows = max(0, buffer_rows);
+        buf_in = aligned_new<T>((size_t)this->buffer_rows * in + in);
+        buf_out = aligned_new<T>((size_t)this->buffer_rows * out + out);
+        row_in = buf_in + (size_t)this->buffer_rows * in;
+        row_out = buf_out + (size_t)this->buffer_rows * out;
+        chunk_begin = chunk_end = 0;
+        rewind();
+        reset_stats();
+    }
+
+    ~DatasetStream(){
+        munmap(map, map_sz);
+        aligned_delete(buf_in);
+        aligned_delete(buf_out);
+    }
+
+    DatasetStream(const DatasetStream&) = delete;
+    DatasetStream& operator=(const DatasetStream&) = delete;
+
+    // Back to the first row for the next epoch, the shuffle buffer starts empty again
+    void rewind(){
+        if(chunk_end > chunk_begin) advise(chunk_begin, chunk_end, MADV_DONTNEED);
+        next_row = 0;
+        chunk_begin = chunk_end = 0;
+        buffered = 0;
+    }
+
+    // x and y stay valid until the next call, false once the epoch is over
+    bool next(const T*& x, const T*& y){
+        if(buffer_rows == 0){
+            if(next_row >= n) return false;
+            if(next_row == chunk_end) load_chunk();
+            x = inputs + (size_t)next_row * in;
+            y = targets + (size_t)next_row * out;
+            next_row++;
+            samples++;
+            return true;
+        }
+
+        while(buffered < buffer_rows && next_row < n){
+            pull(buffered++);
+        }
+        if(buffered == 0) return false;
+
+        // Hand out a random slot and refill it, or close the gap once the file is exhausted
+        int j = uniform_int_distribution<int>(0, buffered - 1)(rng);
+        memcpy(row_in, buf_in + (size_t)j * in, in * sizeof(T));
+        memcpy(row_out, buf_out + (size_t)j * out, out * sizeof(T));
+        if(next_row < n){
+            pull(j);
+        }else{
+            buffered--;
+            memcpy(buf_in + (size_t)j * in, buf_in + (size_t)buffered * in, in * sizeof(T));
+            memcpy(buf_out + (size_t)j * out, buf_out + (size_t)buffered * out, out * sizeof(T));
+        }
+        x = row_in;
+        y = row_out;
+        samples++;
+        return true;
+    }
+
+    // Copies the next row of the file into slot
+    void pull(int slot){
+        if(next_row == chunk_end) load_chunk();
+        memcpy(buf_in + (size_t)slot * in, inputs + (size_t)next_row * in, in * sizeof(T));
+        memcpy(buf_out + (size_t)slot * out, targets + (size_t)next_row * out, out * sizeof(T));
+        next_row++;
+    }
+
+    void load_chunk(){
+        auto startTime = chrono::steady_clock::now();
+        long long from = next_row;
+        long long to = min(n, from + chunk_rows);
+
+        // Done with the previous chunk, ask for the one after this one
+        if(chunk_end > chunk_begin) advise(chunk_begin, chunk_end, MADV_DONTNEED);
+        if(to < n) advise(to, min(n, to + chunk_rows), MADV_WILLNEED);
+
+        // Touch every page now, so the wait for the disk is counted here and not in the training loop
+        volatile char sink = 0;
+        const char* sections[] = {(const char*)(inputs + (size_t)from * in), (const char*)(targets + (size_t)from * out)};
+        size_t sizes[] = {(size_t)(to - from) * in * sizeof(T), (size_t)(to - from) * out * sizeof(T)};
+        for(int s = 0; s < 2; s++){
+            for(size_t k = 0; k < sizes[s]; k += DATASET_ALIGN) sink = sink + sections[s][k];
+            if(sizes[s] > 0) sink = sink + sections[s][sizes[s] - 1];
+        }
+
+        chunk_begin = from;
+        chunk_end = to;
+        bytes_read += sizes[0] + sizes[1];
+        io_ns += chrono::duration<double, nano>(chrono::steady_clock::now() - startTime).count();
+    }
+
+    // Rows [from, to) of both sections, widened to whole pages
+    void advise(long long from, long long to, int advice){
+        const char* sections[] = {(const char*)inputs, (const char*)targets};
+        int widths[] = {in, out};
+        for(int s = 0; s < 2; s++){
+            size_t a = (size_t)(sections[s] - (const char*)map) + (size_t)from * widths[s] * sizeof(T);
+            size_t b = (size_t)(sections[s] - (const char*)map) + (size_t)to * widths[s] * sizeof(T);
+            a = a / DATASET_ALIGN * DATASET_ALIGN;
+            b = min(map_sz, (size_t)dataset_align(b));
+            if(b > a) madvise((char*)map + a, b - a, advice);
+        }
+    }
+
+    void reset_stats(){
+        samples = 0;
+        bytes_read = 0;
+        io_ns = 0;
+        started = chrono::steady_clock::now();
+    }
+
+    // I/O throughput while waiting on the file next to the sample rate of everything else
+    string throughput(){
+        double total_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - started).count();
+        double compute_ns = max(1.0, total_ns - io_ns);
+        char res[160];
+        snprintf(res, sizeof(res), "I/O %.1f MB/s (%.0f%% of the time), compute %.0f samples/s",
+            io_ns > 0 ? bytes_read / io_ns * 1e3 : 0.0, 100 * io_ns / max(1.0, total_ns), samples / compute_ns * 1e9);
+        return res;
+    }
+};
+
+#endif
@@ -0,0 +1,388 @@
+#include "kernels.hpp"
+#include "memory.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+// ================== Blocking ==================
+
+// Column blocks keep the touched part of B and a row of C inside L1/L2
+#define BLOCK_N 256
+
+// Packed path: a KC x NR sliver of B stays in L1, an MC x KC block of A in L2
+// and a KC x NC panel of B in L3, the micro-kernel owns an MR x NR tile of C
+#define GEMM_MR 4
+#define GEMM_NR 8 // in doubles, Tile<T>::NR keeps the same width in bytes
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 2048
+
+template<typename T>
+struct Tile {
+    static const int NR = GEMM_NR * sizeof(double) / sizeof(T);
+};
+
+// Below this many multiply-adds packing costs more than it saves
+#define GEMM_PACK_MIN (32 * 32 * 32)
+
+// ================== Loop Orders ==================
+
+// Every variant keeps the innermost loop on contiguous memory
+
+// C += alpha * A * B, inner loop runs along rows of B and C
+// Four rows of B are folded into each pass over a row of C
+template<typename T>
+static void gemm_nn(int m, int n, int k, T alpha, const T* A, int lda, const T* B, int ldb, T* C, int ldc){
+    for(int jj = 0; jj < n; jj += BLOCK_N){
+        int je = min(n, jj + BLOCK_N);
+        for(int i = 0; i < m; i++){
+            T* __restrict c = C + (size_t)i * ldc;
+            const T* a = A + (size_t)i * lda;
+            int p = 0;
+            for(; p + 4 <= k; p += 4){
+                T s0 = alpha * a[p], s1 = alpha * a[p+1], s2 = alpha * a[p+2], s3 = alpha * a[p+3];
+                const T* __restrict b0 = B + (size_t)p * ldb;
+                const T* __restrict b1 = b0 + ldb;
+                const T* __restrict b2 = b1 + ldb;
+                const T* __restrict b3 = b2 + ldb;
+                for(int j = jj; j < je; j++){
+                    c[j] += s0 * b0[j] + s1 * b1[j] + s2 * b2[j] + s3 * b3[j];
+                }
+            }
+            for(; p < k; p++){
+                T s = alpha * a[p];
+                const T* __restrict b = B + (size_t)p * ldb;
+                for(int j = jj; j < je; j++){
+                    c[j] += s * b[j];
+                }
+            }
+        }
+    }
+}
+
+// C += alpha * A * B^T, rows of A and B are dotted together
+// 4x4 tiles of C are kept in registers so every loaded value is used 4 times
+template<typename T>
+static void gemm_nt(int m, int n, int k, T alpha, const T* A, int lda, const T* B, int ldb, T* C, int ldc){
+    int i = 0;
+    for(; i + 4 <= m; i += 4){
+        const T* a0 = A + (size_t)i * lda;
+        const T* a1 = a0 + lda;
+        const T* a2 = a1 + lda;
+        const T* a3 = a2 + lda;
+        int j = 0;
+        for(; j + 4 <= n; j += 4){
+            const T* b0 = B + (size_t)j * ldb;
+            const T* b1 = b0 + ldb;
+            const T* b2 = b1 + ldb;
+            const T* b3 = b2 + ldb;
+            T c[4][4] = {};
+            for(int p = 0; p < k; p++){
+                T x[4] = {a0[p], a1[p], a2[p], a3[p]};
+                T y[4] = {b0[p], b1[p], b2[p], b3[p]};
+                for(int u = 0; u < 4; u++){
+                    for(int v = 0; v < 4; v++){
+                        c[u][v] += x[u] * y[v];
+                    }
+                }
+            }
+            for(int u = 0; u < 4; u++){
+                for(int v = 0; v < 4; v++){
+                    C[(size_t)(i+u) * ldc + j+v] += alpha * c[u][v];
+                }
+            }
+        }
+        // Leftover columns
+        for(; j < n; j++){
+            const T* b = B + (size_t)j * ldb;
+            for(int u = 0; u < 4; u++){
+                const T* a = A + (size_t)(i+u) * lda;
+                T sum = 0;
+                for(int p = 0; p < k; p++){
+                    sum += a[p] * b[p];
+                }
+                C[(size_t)(i+u) * ldc + j] += alpha * sum;
+            }
+        }
+    }
+    // Leftover rows
+    for(; i < m; i++){
+        const T* a = A + (size_t)i * lda;
+        for(int j = 0; j < n; j++){
+            const T* b = B + (size_t)j * ldb;
+            T sum = 0;
+            for(int p = 0; p < k; p++){
+                sum += a[p] * b[p];
+            }
+            C[(size_t)i * ldc + j] += alpha * sum;
+        }
+    }
+}
+
+// C += alpha * A^T * B, a sum of rank-1 updates over the rows of A and B
+// Each row of C takes four rank-1 updates per pass
+template<typename T>
+static void gemm_tn(int m, int n, int k, T alpha, const T* A, int lda, const T* B, int ldb, T* C, int ldc){
+    for(int jj = 0; jj < n; jj += BLOCK_N){
+        int je = min(n, jj + BLOCK_N);
+        for(int i = 0; i < m; i++){
+            T* __restrict c = C + (size_t)i * ldc;
+            int p = 0;
+            for(; p + 4 <= k; p += 4){
+                T s0 = alpha * A[(size_t)p * lda + i];
+                T s1 = alpha * A[(size_t)(p+1) * lda + i];
+                T s2 = alpha * A[(size_t)(p+2) * lda + i];
+                T s3 = alpha * A[(size_t)(p+3) * lda + i];
+                const T* __restrict b0 = B + (size_t)p * ldb;
+                const T* __restrict b1 = b0 + ldb;
+                const T* __restrict b2 = b1 + ldb;
+                const T* __restrict b3 = b2 + ldb;
+                for(int j = jj; j < je; j++){
+                    c[j] += s0 * b0[j] + s1 * b1[j] + s2 * b2[j] + s3 * b3[j];
+                }
+            }
+            for(; p < k; p++){
+                T s = alpha * A[(size_t)p * lda + i];
+                const T* __restrict b = B + (size_t)p * ldb;
+                for(int j = jj; j < je; j++){
+                    c[j] += s * b[j];
+                }
+            }
+        }
+    }
+}
+
+// C += alpha * A^T * B^T, rarely used so it stays simple
+template<typename T>
+static void gemm_tt(int m, int n, int k, T alpha, const T* A, int lda, const T* B, int ldb, T* C, int ldc){
+    for(int i = 0; i < m; i++){
+        for(int j = 0; j < n; j++){
+            T sum = 0;
+            for(int p = 0; p < k; p++){
+                sum += A[(size_t)p * lda + i] * B[(size_t)j * ldb + p];
+            }
+            C[(size_t)i * ldc + j] += alpha * sum;
+        }
+    }
+}
+
+// ================== Packing ==================
+
+// Per-thread packing buffers, allocated on first use and kept for reuse
+// A thread waiting on the pool can pick up another GEMM, so every nesting level gets its own pair
+template<typename T>
+struct PackBuffers {
+    T* a;
+    T* b;
+    PackBuffers(){
+        a = nullptr;
+        b = nullptr;
+    }
+    ~PackBuffers(){
+        aligned_delete(a);
+        aligned_delete(b);
+    }
+    T* get_a(){
+        if(a == nullptr) a = aligned_new<T>(GEMM_MC * GEMM_KC);
+        return a;
+    }
+    T* get_b(){
+        if(b == nullptr) b = aligned_new<T>(GEMM_KC * GEMM_NC);
+        return b;
+    }
+};
+
+template<typename T>
+struct PackStack {
+    vector<PackBuffers<T>*> levels;
+    int depth;
+    PackStack(){
+        depth = 0;
+    }
+    ~PackStack(){
+        for(PackBuffers<T>* p : levels) delete p;
+    }
+};
+
+// Holds the calling thread's buffers for the current nesting level
+template<typename T>
+struct PackScope {
+    PackStack<T>& stack;
+    PackBuffers<T>* buf;
+    PackScope() : stack(pack_stack()) {
+        if(stack.depth == (int)stack.levels.size()) stack.levels.push_back(new PackBuffers<T>());
+        buf = stack.levels[stack.depth++];
+    }
+    ~PackScope(){
+        stack.depth--;
+    }
+    static PackStack<T>& pack_stack(){
+        static thread_local PackStack<T> stack;
+        return stack;
+    }
+};
+
+// Copies an mc x kc block of op(A) into MR-row slivers, each stored column by column
+// Rows past mc are zero so the micro-kernel never needs an edge case
+template<typename T>
+static void pack_a(bool trans, int mc, int kc, const T* A, int lda, T* dst){
+    for(int i = 0; i < mc; i += GEMM_MR){
+        int mr = min(GEMM_MR, mc - i);
+        for(int p = 0; p < kc; p++){
+            for(int u = 0; u < mr; u++){
+                dst[u] = trans ? A[(size_t)p * lda + i + u] : A[(size_t)(i + u) * lda + p];
+            }
+            for(int u = mr; u < GEMM_MR; u++) dst[u] = 0;
+            dst += GEMM_MR;
+        }
+    }
+}
+
+// Copies a kc x nc panel of op(B) into NR-column slivers, each stored row by row
+template<typename T>
+static void pack_b(bool trans, int kc, int nc, const T* B, int ldb, T* dst){
+    const int NR = Tile<T>::NR;
+    for(int j = 0; j < nc; j += NR){
+        int nr = min(NR, nc - j);
+        for(int p = 0; p < kc; p++){
+            for(int v = 0; v < nr; v++){
+                dst[v] = trans ? B[(size_t)(j + v) * ldb + p] : B[(size_t)p * ldb + j + v];
+            }
+            for(int v = nr; v < NR; v++) dst[v] = 0;
+            dst += NR;
+        }
+    }
+}
+
+// ================== Micro-kernel ==================
+
+// C[0:mr, 0:nr] += alpha * a * b for one packed sliver pair
+// The MR x NR accumulator is sized to stay in vector registers
+template<typename T>
+static void micro_kernel(int kc, T alpha, const T* __restrict a, const T* __restrict b, T* C, int ldc, int mr, int nr){
+    const int NR = Tile<T>::NR;
+    T acc[GEMM_MR][NR] = {};
+    for(int p = 0; p < kc; p++){
+        for(int u = 0; u < GEMM_MR; u++){
+            T x = a[u];
+            for(int v = 0; v < NR; v++){
+                acc[u][v] += x * b[v];
+            }
+        }
+        a += GEMM_MR;
+        b += NR;
+    }
+    for(int u = 0; u < mr; u++){
+        T* c = C + (size_t)u * ldc;
+        for(int v = 0; v < nr; v++){
+            c[v] += alpha * acc[u][v];
+        }
+    }
+}
+
+// ================== Packed GEMM ==================
+
+// One MC-row block of C against a packed panel of B
+template<typename T>
+static void gemm_block(bool transA, int ic, int mc, int pc, int kc, int jc, int nc, T alpha, const T* A, int lda, const T* Bpack, T* C, int ldc){
+    const int NR = Tile<T>::NR;
+    PackScope<T> scope;
+    T* Apack = scope.buf->get_a();
+    const T* Ap = transA ? A + (size_t)pc * lda + ic : A + (size_t)ic * lda + pc;
+    pack_a(transA, mc, kc, Ap, lda, Apack);
+
+    for(int jr = 0; jr < nc; jr += NR){
+        const T* b = Bpack + (size_t)jr * kc;
+        for(int ir = 0; ir < mc; ir += GEMM_MR){
+            const T* a = Apack + (size_t)ir * kc;
+            T* c = C + (size_t)(ic + ir) * ldc + jc + jr;
+            micro_kernel(kc, alpha, a, b, c, ldc, min(GEMM_MR, mc - ir), min(NR, nc - jr));
+        }
+    }
+}
+
+// Row blocks of C are independent, so they are spread over the thread pool once there are enough of them
+template<typename T>
+static void gemm_packed(bool transA, bool transB, int m, int n, int k, T alpha, const T* A, int lda, const T* B, int ldb, T* C, int ldc){
+    PackScope<T> scope;
+    T* Bpack = scope.buf->get_b();
+    int blocks = (m + GEMM_MC - 1) / GEMM_MC;
+    for(int jc = 0; jc < n; jc += GEMM_NC){
+        int nc = min(GEMM_NC, n - jc);
+        for(int pc = 0; pc < k; pc += GEMM_KC){
+            int kc = min(GEMM_KC, k - pc);
+            const T* Bp = transB ? B + (size_t)jc * ldb + pc : B + (size_t)pc * ldb + jc;
+            pack_b(transB, kc, nc, Bp, ldb, Bpack);
+
+            parallel_for(blocks, [&](int blk){
+                int ic = blk * GEMM_MC;
+                gemm_block(transA, ic, min(GEMM_MC, m - ic), pc, kc, jc, nc, alpha, A, lda, Bpack, C, ldc);
+            });
+        }
+    }
+}
+
+// ================== GEMM ==================
+
+template<typename T>
+static void gemm_any(bool transA, bool transB, int m, int n, int k,
+                     T alpha, const T* A, int lda,
+                     const T* B, int ldb,
+                     T beta, T* C, int ldc){
+    for(int i = 0; i < m; i++){
+        T* c = C + (size_t)i * ldc;
+        if(beta == 0){
+            fill(c, c + n, T(0));
+        }else if(beta != 1){
+            for(int j = 0; j < n; j++) c[j] *= beta;
+        }
+    }
+    if(m == 0 || n == 0 || k == 0 || alpha == 0) return;
+
+    // Thin products (matrix-vector) have nothing to reuse, stream them directly
+    if(m < GEMM_MR || n < Tile<T>::NR || (long long)m * n * k < GEMM_PACK_MIN){
+        if(!transA && !transB)      gemm_nn(m, n, k, alpha, A, lda, B, ldb, C, ldc);
+        else if(!transA && transB)  gemm_nt(m, n, k, alpha, A, lda, B, ldb, C, ldc);
+        else if(transA && !transB)  gemm_tn(m, n, k, alpha, A, lda, B, ldb, C, ldc);
+        else                        gemm_tt(m, n, k, alpha, A, lda, B, ldb, C, ldc);
+        return;
+    }
+    gemm_packed(transA, transB, m, n, k, alpha, A, lda, B, ldb, C, ldc);
+}
+
+template<typename T>
+static void gemm_ref_any(bool transA, bool transB, int m, int n, int k,
+                         T alpha, const T* A, int lda,
+                         const T* B, int ldb,
+                         T beta, T* C, int ldc){
+    for(int i = 0; i < m; i++){
+        for(int j = 0; j < n; j++){
+            T sum = 0;
+            for(int p = 0; p < k; p++){
+                T a = transA ? A[(size_t)p * lda + i] : A[(size_t)i * lda + p];
+                T b = transB ? B[(size_t)j * ldb + p] : B[(size_t)p * ldb + j];
+                sum += a * b;
+            }
+            T& c = C[(size_t)i * ldc + j];
+            c = alpha * sum + (beta == 0 ? 0 : beta * c);
+        }
+    }
+}
+
+void gemm(bool transA, bool transB, int m, int n, int k, double alpha, const double* A, int lda, const double* B, int ldb, double beta, double* C, int ldc){
+    gemm_any(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void gemm(bool transA, bool transB, int m, int n, int k, float alpha, const float* A, int lda, const float* B, int ldb, float beta, float* C, int ldc){
+    gemm_any(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void gemm_ref(bool transA, bool transB, int m, int n, int k, double alpha, const double* A, int lda, const double* B, int ldb, double beta, double* C, int ldc){
+    gemm_ref_any(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void gemm_ref(bool transA, bool transB, int m, int n, int k, float alpha, const float* A, int lda, const float* B, int ldb, float beta, float* C, int ldc){
+    gemm_ref_any(transA, transB, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
@@ -0,0 +1,69 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+// ================== Dense Kernels ==================
+
+// All matrices are row-major, ld* is the distance between rows
+
+// C = alpha * op(A) * op(B) + beta * C, op(X) = X or X^T
+// op(A) is m x k, op(B) is k x n, C is m x n
+void gemm(bool transA, bool transB, int m, int n, int k,
+          double alpha, const double* A, int lda,
+          const double* B, int ldb,
+          double beta, double* C, int ldc);
+void gemm(bool transA, bool transB, int m, int n, int k,
+          float alpha, const float* A, int lda,
+          const float* B, int ldb,
+          float beta, float* C, int ldc);
+
+// Same contract as gemm, plain triple loop kept to verify the fast paths
+void gemm_ref(bool transA, bool transB, int m, int n, int k,
+              double alpha, const double* A, int lda,
+              const double* B, int ldb,
+              double beta, double* C, int ldc);
+void gemm_ref(bool transA, bool transB, int m, int n, int k,
+              float alpha, const float* A, int lda,
+              const float* B, int ldb,
+              float beta, float* C, int ldc);
+
+// ================== Activation Kernels ==================
+
+// Instruction sets, ordered so a bigger value means a wider kernel
+#define ISA_SCALAR 0
+#define ISA_SSE2 1
+#define ISA_AVX2 2
+#define ISA_AVX512 3
+
+// sigmoid is within a few ulps of the scalar one and NaN stays NaN, below -708 (-87 for float) it saturates
+// at about 3e-308 (1.6e-38) instead of reaching 0. relu and the derivatives match the scalar ones exactly, relu(NaN) is 0
+template<typename T>
+struct ActKernels {
+    // y[i] = f(x[i]) over a whole layer
+    typedef void (*Act)(const T* x, T* y, int n);
+    // g[i] *= f'(x[i], y[i]) over a whole layer, x is before and y after activation
+    typedef void (*ActD)(const T* x, const T* y, T* g, int n);
+
+    int isa;
+    const char* name;
+    Act sigmoid;
+    ActD sigmoid_d;
+    Act relu;
+    ActD relu_d;
+};
+
+// Best instruction set this CPU supports, read from cpuid once, ISA_SCALAR on anything but x86
+int cpu_isa();
+
+// Kernels for a given instruction set, falls back to narrower ones if unsupported
+template<typename T> ActKernels<T> act_kernels(int isa);
+template<> ActKernels<float> act_kernels<float>(int isa);
+template<> ActKernels<double> act_kernels<double>(int isa);
+
+// Kernels for cpu_isa(), chosen once on first call
+template<typename T>
+const ActKernels<T>& act_kernels(){
+    static const ActKernels<T> best = act_kernels<T>(cpu_isa());
+    return best;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+// ================== Allocation Counter ==================
+
+// Every heap allocation FastNN makes goes through the counter, and so does
+// operator new when alloc_hook.hpp is part of the program
+inline atomic<size_t>& alloc_counter(){
+    static atomic<size_t> count(0);
+    return count;
+}
+
+inline size_t alloc_count(){
+    return alloc_counter().load();
+}
+
+// ================== Aligned Memory ==================
+
+template<typename T>
+T* aligned_new(size_t n, size_t align = 64){
+    void* p = nullptr;
+    alloc_counter()++;
+    if(posix_memalign(&p, align, n * sizeof(T)) != 0) throw bad_alloc();
+    return (T*)p;
+}
+
+inline void aligned_delete(void* p){
+    free(p);
+}
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef PREFETCH_HPP
+#define PREFETCH_HPP
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+#include "FNN.hpp"
+#include "dataset.hpp"
+#include "dataset_file.hpp"
+#include "memory.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+// Builds the next mini-batches on a thread of its own while the current one trains
+// A producer gathers rows (through the shuffled order or from a stream), normalizes them and writes
+// them straight into the layout train_batch works on, then hands the buffer over through a lock-free queue
+
+// ================== Global Variables ==================
+
+#define PREFETCH_DEPTH 3  // batches in flight, one training and the rest being filled or waiting
+#define PREFETCH_MAX 16
+#define PREFETCH_ALIGN 64
+
+// ================== SPSC Queue ==================
+
+// One producer, one consumer, indices of batch buffers only
+// Head and tail sit on their own cache lines so the two threads never write the same line
+struct SpscQueue {
+char pad_front[PREFETCH_ALIGN];
+atomic<unsigned> head; // next slot to pop, written by the consumer
+char pad_mid[PREFETCH_ALIGN];
+atomic<unsigned> tail; // next slot to push, written by the producer
+char pad_back[PREFETCH_ALIGN];
+int items[PREFETCH_MAX];
+
+    SpscQueue() : head(0), tail(0) {}
+
+    bool push(int v){
+        unsigned t = tail.load(memory_order_relaxed);
+        if(t - head.load(memory_order_acquire) == PREFETCH_MAX) return false;
+        items[t % PREFETCH_MAX] = v;
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    bool pop(int& v){
+        unsigned h = head.load(memory_order_relaxed);
+        if(tail.load(memory_order_acquire) == h) return false;
+        v = items[h % PREFETCH_MAX];
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+};
+
+// ================== Prefetcher ==================
+
+template<typename T>
+struct PrefetchBatch {
+T* inputs;   // rows x (in+1), bias column included, like FNN::batchInput
+T* targets;  // rows x out, FNN::train_batch turns them into the output deltas in place
+int rows;
+bool last;   // closes an epoch, may be empty
+};
+
+template<typename T>
+class BatchPrefetcher {
+public:
+// Exactly one of the sources is set
+Dataset<T>* data;
+DatasetStream<T>* stream;
+bool shuffle;   // Dataset only, reorders it before every epoch
+int batch_size;
+int in;         // input width, without the bias
+int out;
+
+// Optional (x - mean) * scale per input feature, applied by the producer
+T* mean;
+T* scale;
+
+int depth;
+PrefetchBatch<T> batches[PREFETCH_MAX];
+SpscQueue ready;  // producer to consumer
+SpscQueue spare;  // consumer to producer
+thread producer;
+int epochs;
+atomic<bool> stopping; // set by the destructor and start(), so a producer waiting for a spare buffer gives up
+
+// Stall counters, a stall is a wait that found its queue empty
+// Consumer stalls mean the trainer waits on input, producer stalls mean input is ahead of training
+long long produced;
+long long consumer_stalls;
+long long producer_stalls;
+double consumer_stall_ns;
+double producer_stall_ns;
+
+    BatchPrefetcher(Dataset<T>& data, int batch_size, bool shuffle = false, int depth = PREFETCH_DEPTH)
+        : data(&data), stream(nullptr), shuffle(shuffle), batch_size(batch_size), in(data.in), out(data.out) {
+        setup(depth);
+    }
+
+    BatchPrefetcher(DatasetStream<T>& stream, int batch_size, int depth = PREFETCH_DEPTH)
+        : data(nullptr), stream(&stream), shuffle(false), batch_size(batch_size), in(stream.in), out(stream.out) {
+        setup(depth);
+    }
+
+    // The consumer may stop early (an exception in training), the producer would then wait for a spare forever
+    ~BatchPrefetcher(){
+        stopping.store(true, memory_order_relaxed);
+        finish();
+        for(int b = 0; b < depth; b++){
+            aligned_delete(batches[b].inputs);
+            aligned_delete(batches[b].targets);
+        }
+        aligned_delete(mean);
+    }
+
+    BatchPrefetcher(const BatchPrefetcher&) = delete;
+    BatchPrefetcher& operator=(const BatchPrefetcher&) = delete;
+
+    void setup(int depth){
+        if(batch_size <= 0) throw invalid_argument("batch_size has to be positive, got " + to_string(batch_size));
+        this->depth = max(2, min(depth, PREFETCH_MAX));
+        for(int b = 0; b < this->depth; b++){
+            batches[b].inputs = aligned_new<T>((size_t)batch_size * (in + 1), PREFETCH_ALIGN);
+            batches[b].targets = aligned_new<T>((size_t)batch_size * out, PREFETCH_ALIGN);
+            batches[b].rows = 0;
+            batches[b].last = false;
+        }
+        mean = scale = nullptr;
+        epochs = 0;
+        stopping.store(false, memory_order_relaxed);
+        reset_stats();
+    }
+
+    // Copies both, call before start()
+    void normalize(const T* mean, const T* scale){
+        if(this->mean == nullptr){
+            this->mean = aligned_new<T>(2 * in, PREFETCH_ALIGN);
+            this->scale = this->mean + in;
+        }
+        copy(mean, mean + in, this->mean);
+        copy(scale, scale + in, this->scale);
+    }
+
+    void reset_stats(){
+        produced = consumer_stalls = producer_stalls = 0;
+        consumer_stall_ns = producer_stall_ns = 0;
+    }
+
+    // Starts producing epochs worth of batches, every buffer begins on the spare queue
+    // A producer still running from an abandoned start is stopped first
+    void start(int epochs){
+        stopping.store(true, memory_order_relaxed);
+        finish();
+        stopping.store(false, memory_order_relaxed);
+        this->epochs = epochs;
+        int b;
+        while(ready.pop(b)){}
+        while(spare.pop(b)){}
+        for(b = 0; b < depth; b++) spare.push(b);
+        producer = thread([this]{ produce(); });
+    }
+
+    void finish(){
+        if(producer.joinable()) producer.join();
+    }
+
+    // Next full batch, waits if the producer is behind
+    PrefetchBatch<T>* acquire(){
+        int b;
+        if(!ready.pop(b)){
+            consumer_stalls++;
+            consumer_stall_ns += wait(ready, b);
+            if(b < 0) throw runtime_error("BatchPrefetcher stopped");
+        }
+        return &batches[b];
+    }
+
+    void release(PrefetchBatch<T>* batch){
+        spare.push((int)(batch - batches));
+    }
+
+    // Spins like the pool does, then yields so a producer on the same core can run
+    // Gives up with b = -1 once stopping is set
+    double wait(SpscQueue& q, int& b){
+        auto startTime = chrono::steady_clock::now();
+        int idle = 0;
+        while(!q.pop(b)){
+            if(stopping.load(memory_order_relaxed)){
+                b = -1;
+                break;
+            }
+            if(++idle < POOL_SPIN) cpu_relax();
+            else this_thread::yield();
+        }
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - startTime).count();
+    }
+
+    void produce(){
+        const T* x;
+        const T* y;
+        for(int e = 0; e < epochs; e++){
+            if(data != nullptr && shuffle) data->shuffle();
+            if(stream != nullptr) stream->rewind();
+            long long row = 0;
+            bool more = true;
+            while(more){
+                int b;
+                if(!spare.pop(b)){
+                    producer_stalls++;
+                    producer_stall_ns += wait(spare, b);
+                    if(b < 0) return;
+                }
+                PrefetchBatch<T>& batch = batches[b];
+                int r = 0;
+                while(r < batch_size){
+                    if(data != nullptr){
+                        more = row < data->n;
+                        if(!more) break;
+                        x = data->input_at(row);
+                        y = data->target_at(row);
+                        row++;
+                    }else if(!(more = stream->next(x, y))){
+                        break;
+                    }
+                    fill_row(batch, r++, x, y);
+                }
+                // The batch holding the last row closes the epoch, even when it is full
+                if(more && data != nullptr && row == data->n) more = false;
+                batch.rows = r;
+                batch.last = !more;
+                produced++;
+                ready.push(b);
+            }
+        }
+    }
+
+    void fill_row(PrefetchBatch<T>& batch, int r, const T* x, const T* y){
+        T* dst = batch.inputs + (size_t)r * (in + 1);
+        if(mean != nullptr){
+            for(int k = 0; k < in; k++) dst[k] = (x[k] - mean[k]) * scale[k];
+        }else{
+            for(int k = 0; k < in; k++) dst[k] = x[k];
+        }
+        dst[in] = 1;
+        T* t = batch.targets + (size_t)r * out;
+        for(int j = 0; j < out; j++) t[j] = y[j];
+    }
+
+    string report(){
+        char res[200];
+        snprintf(res, sizeof(res), "%lld batches, trainer waited %lld times (%.1f ms), producer waited %lld times (%.1f ms): %s",
+            produced, consumer_stalls, consumer_stall_ns / 1e6, producer_stalls, producer_stall_ns / 1e6,
+            consumer_stall_ns > producer_stall_ns ? "input-bound" : "compute-bound");
+        return res;
+    }
+};
+
+#endif
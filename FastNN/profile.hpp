@@ -0,0 +1,69 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <cstdint>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+// Per layer, per phase counters for FNN's hot paths
+// Built with -DFNN_PROFILE the phases are timed with the cycle counter, without it the macros below
+// expand to nothing and FNN::stats() stays empty
+
+// ================== Global Variables ==================
+
+// Phases
+#define PROF_FORWARD 0     // weights times input
+#define PROF_ACTIVATION 1
+#define PROF_DELTA 2       // output error, weights^T times the next delta (batched) and the activation derivative
+#define PROF_UPDATE 3      // weights += lr * delta * input^T, one sample at a time it also propagates the delta
+#define PROF_PHASES 4
+
+// Work on a weight matrix is charged to the layer that owns it, work on a layer's outputs to that layer
+// So weights_flat[i+1]^T times delta[i+1] counts as layer i+1's delta and the derivative that turns it into
+// delta[i] as layer i's, and a layer can have two delta calls per sample
+
+// ================== Counters ==================
+
+struct PhaseStats {
+long long calls;
+uint64_t cycles;
+double flops;  // estimated from the layer sizes
+double bytes;  // estimated memory traffic, every operand counted once
+};
+
+struct LayerStats {
+PhaseStats phases[PROF_PHASES];
+};
+
+// TSC ticks on x86, nanoseconds elsewhere
+inline uint64_t read_cycles(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// stats is null on paths that are not counted, e.g. the worker threads of the parallel trainers
+inline void profile_add(LayerStats* stats, int layer, int phase, uint64_t start, double flops, double bytes){
+    if(stats == nullptr) return;
+    PhaseStats& p = stats[layer].phases[phase];
+    p.calls++;
+    p.cycles += read_cycles() - start;
+    p.flops += flops;
+    p.bytes += bytes;
+}
+
+#ifdef FNN_PROFILE
+#define PROF_START(t) uint64_t t = read_cycles()
+#define PROF_STOP(t, stats, layer, phase, flops, bytes) profile_add(stats, layer, phase, t, flops, bytes)
+#else
+#define PROF_START(t)
+#define PROF_STOP(t, stats, layer, phase, flops, bytes)
+#endif
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <type_traits>
+#include <cstdlib>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Persistent work-stealing thread pool, header only so any callable is inlined into its task
+
+// ================== Global Variables ==================
+
+#define POOL_QUEUE 256   // tasks per deque, a full deque runs the task inline instead
+#define POOL_SPIN 2000   // empty polls before an idle worker parks
+#define POOL_ALIGN 64
+
+static_assert((POOL_QUEUE & (POOL_QUEUE - 1)) == 0, "TaskDeque indices wrap around, POOL_QUEUE has to divide 2^32");
+
+// ================== Tasks ==================
+
+// Runs [from, to) of the loop body behind ctx, ranges longer than grain get split in half
+struct Task {
+void (*fn)(void* ctx, int from, int to);
+void* ctx;
+int from;
+int to;
+int grain;
+atomic<int>* pending; // tasks of the same call that have not finished yet
+};
+
+template<typename F>
+static void task_each(void* ctx, int from, int to){
+    F& f = *(F*)ctx;
+    for(int i = from; i < to; i++) f(i);
+}
+
+template<typename F>
+static void task_range(void* ctx, int from, int to){
+    (*(F*)ctx)(from, to);
+}
+
+template<typename F>
+static void task_once(void* ctx, int from, int to){
+    (*(F*)ctx)();
+}
+
+inline void cpu_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    this_thread::yield();
+#endif
+}
+
+// ================== Task Deque ==================
+
+// The owner pushes and pops at the back (newest, still in cache), thieves take from the front (biggest ranges)
+// Both ends are held for a few nanoseconds, so a spinlock is enough, and nothing is allocated after construction
+struct TaskDeque {
+char pad_front[POOL_ALIGN];
+atomic<bool> locked;
+unsigned head;   // both only count up and wrap around like SpscQueue's, POOL_QUEUE divides 2^32 so the slots stay in order
+unsigned tail;
+Task tasks[POOL_QUEUE];
+char pad_back[POOL_ALIGN];
+
+    TaskDeque() : locked(false), head(0), tail(0) {}
+
+    void lock(){
+        while(locked.exchange(true, memory_order_acquire)) cpu_relax();
+    }
+    bool try_lock(){
+        return !locked.load(memory_order_relaxed) && !locked.exchange(true, memory_order_acquire);
+    }
+    void unlock(){
+        locked.store(false, memory_order_release);
+    }
+
+    bool push(const Task& t){
+        lock();
+        bool ok = tail - head < POOL_QUEUE;
+        if(ok) tasks[tail++ % POOL_QUEUE] = t;
+        unlock();
+        return ok;
+    }
+    bool pop(Task& t){
+        lock();
+        bool ok = tail != head;
+        if(ok) t = tasks[--tail % POOL_QUEUE];
+        unlock();
+        return ok;
+    }
+    bool steal(Task& t){
+        if(!try_lock()) return false;
+        bool ok = tail != head;
+        if(ok) t = tasks[head++ % POOL_QUEUE];
+        unlock();
+        return ok;
+    }
+};
+
+// ================== Thread Pool ==================
+
+class ThreadPool;
+
+// Pool and deque of the calling thread, -1 for threads outside any pool
+inline ThreadPool*& pool_owner(){
+    static thread_local ThreadPool* pool = nullptr;
+    return pool;
+}
+inline int& pool_index(){
+    static thread_local int index = -1;
+    return index;
+}
+
+class ThreadPool {
+public:
+int n; // worker threads, the calling thread also runs tasks while it waits
+vector<thread> workers;
+vector<TaskDeque> queues; // one per worker, the last one is shared by outside threads
+
+atomic<int> queued;
+atomic<int> sleeping;
+atomic<bool> stop;
+mutex park_mtx;
+condition_variable park_cv;
+
+    // threads < 0 uses every core, the caller counts as one of them
+    ThreadPool(int threads = -1) : queues(1), queued(0), sleeping(0), stop(false) {
+        if(threads < 0) threads = (int)thread::hardware_concurrency() - 1;
+        n = threads < 0 ? 0 : threads;
+        vector<TaskDeque>(n + 1).swap(queues);
+        for(int i = 0; i < n; i++){
+            workers.emplace_back([this, i]{ worker_loop(i); });
+        }
+    }
+
+    ~ThreadPool(){
+        stop.store(true);
+        {
+            lock_guard<mutex> lock(park_mtx);
+            park_cv.notify_all();
+        }
+        for(thread& w : workers) w.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size(){
+        return n + 1;
+    }
+
+    // f(i) for every i in [0, n), at least grain iterations per task
+    template<typename F>
+    void parallel_for(int count, F&& f, int grain = 1){
+        typedef typename remove_reference<F>::type Fn;
+        if(n == 0 || count <= grain){
+            for(int i = 0; i < count; i++) f(i);
+            return;
+        }
+        run(task_each<Fn>, (void*)&f, count, grain);
+    }
+
+    // f(from, to) over disjoint chunks of [0, n) no longer than grain, for bodies that vectorize over the range
+    template<typename F>
+    void parallel_for_range(int count, F&& f, int grain = 1){
+        typedef typename remove_reference<F>::type Fn;
+        if(n == 0 || count <= grain){
+            if(count > 0) f(0, count);
+            return;
+        }
+        run(task_range<Fn>, (void*)&f, count, grain);
+    }
+
+    // Splits the range on the calling thread, the halves it does not get to are left for the other threads
+    void run(void (*fn)(void*, int, int), void* ctx, int count, int grain){
+        atomic<int> pending(1);
+        Task t = {fn, ctx, 0, count, grain < 1 ? 1 : grain, &pending};
+        execute(t);
+        wait(pending);
+    }
+
+    // Pushes a task to the calling thread's deque and wakes a parked worker
+    bool push(const Task& t){
+        int q = pool_owner() == this ? pool_index() : n;
+        if(!queues[q].push(t)) return false;
+        queued.fetch_add(1);
+        if(sleeping.load() > 0){
+            lock_guard<mutex> lock(park_mtx);
+            park_cv.notify_one();
+        }
+        return true;
+    }
+
+    void execute(Task t){
+        while(t.to - t.from > t.grain){
+            int mid = t.from + (t.to - t.from) / 2;
+            Task right = t;
+            right.from = mid;
+            t.pending->fetch_add(1, memory_order_relaxed);
+            if(!push(right)){
+                t.pending->fetch_sub(1, memory_order_relaxed);
+                break;
+            }
+            t.to = mid;
+        }
+        t.fn(t.ctx, t.from, t.to);
+        t.pending->fetch_sub(1, memory_order_release);
+    }
+
+    // Own deque first, then the others round robin
+    bool find_task(Task& t){
+        int self = pool_owner() == this ? pool_index() : n;
+        bool found = queues[self].pop(t);
+        for(int i = 1; !found && i <= n; i++){
+            found = queues[(self + i) % (n + 1)].steal(t);
+        }
+        if(found) queued.fetch_sub(1);
+        return found;
+    }
+
+    // Runs other tasks until every task of the call is done, so nested calls never block a worker
+    void wait(atomic<int>& pending){
+        int idle = 0;
+        while(pending.load(memory_order_acquire) != 0){
+            Task t;
+            if(find_task(t)){
+                execute(t);
+                idle = 0;
+            }else if(++idle < POOL_SPIN){
+                cpu_relax();
+            }else{
+                this_thread::yield();
+            }
+        }
+    }
+
+    // Spins for a while so back to back calls are picked up within microseconds, then parks
+    void worker_loop(int index){
+        pool_owner() = this;
+        pool_index() = index;
+        int idle = 0;
+        while(!stop.load(memory_order_relaxed)){
+            Task t;
+            if(find_task(t)){
+                execute(t);
+                idle = 0;
+                continue;
+            }
+            if(++idle < POOL_SPIN){
+                cpu_relax();
+                continue;
+            }
+            unique_lock<mutex> lock(park_mtx);
+            sleeping.fetch_add(1);
+            park_cv.wait(lock, [this]{ return queued.load() > 0 || stop.load(); });
+            sleeping.fetch_sub(1);
+            idle = 0;
+        }
+    }
+};
+
+// ================== Task Group ==================
+
+// Independent tasks that may spawn more, wait() runs queued tasks instead of blocking
+// Callables are stored by reference and must outlive wait()
+class TaskGroup {
+public:
+ThreadPool& pool;
+atomic<int> pending;
+
+    TaskGroup(ThreadPool& pool) : pool(pool), pending(0) {}
+    ~TaskGroup(){
+        wait();
+    }
+
+    template<typename F>
+    void run(F& f){
+        pending.fetch_add(1, memory_order_relaxed);
+        Task t = {task_once<F>, (void*)&f, 0, 1, 1, &pending};
+        if(pool.n == 0 || !pool.push(t)){
+            f();
+            pending.fetch_sub(1, memory_order_release);
+        }
+    }
+
+    void wait(){
+        pool.wait(pending);
+    }
+};
+
+// ================== Default Pool ==================
+
+// Shared by FNN and the kernels, started on first use
+// The FNN_THREADS environment variable overrides the thread count, the caller included
+inline ThreadPool& thread_pool(){
+    static ThreadPool pool(getenv("FNN_THREADS") ? atoi(getenv("FNN_THREADS")) - 1 : -1);
+    return pool;
+}
+
+template<typename F>
+inline void parallel_for(int n, F&& f, int grain = 1){
+    thread_pool().parallel_for(n, f, grain);
+}
+
+template<typename F>
+inline void parallel_for_range(int n, F&& f, int grain = 1){
+    thread_pool().parallel_for_range(n, f, grain);
+}
+
+#endif
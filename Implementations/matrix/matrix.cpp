@@ -1,49 +1,76 @@
 #include "matrix.hpp"
+#include "../../FastNN/kernels.hpp"
 #include <stdexcept>
 #include <iostream>
 #include <random>
+#include <algorithm>
 
 // ================== Matrix ==================
 
-Matrix::Matrix() {
+template<typename Access>
+BasicMatrix<Access>::BasicMatrix() {
     this->n = 0;
     this->m = 0;
     this->data = nullptr;
 }
 
-Matrix::Matrix(int n) {
-    this->n = n;
-    this->m = 1;
-    this->data = new double[n];
-    for(int i = 0; i < n; i++){
-        data[i] = (double)(rand() % 1000) / 100;
-    }
-}
-
-Matrix::Matrix(int n, int m) {
+template<typename Access>
+BasicMatrix<Access>::BasicMatrix(int n, int m, int init) {
     this->n = n;
     this->m = m;
     this->data = new double[n * m];
-    for(int i = 0; i < n * m; i++){
-        data[i] = (double)(rand() % 1000) / 100;
+    if (init == MATRIX_RANDOM) {
+        for(int i = 0; i < n * m; i++){
+            data[i] = (double)(rand() % 1000) / 100;
+        }
+    } else if (init == MATRIX_ZERO) {
+        fill(data, data + n * m, 0.0);
     }
 }
 
-double& Matrix::operator()(int i) {
-    if (i < 0 || i >= n) {
-        throw std::invalid_argument("Invalid index");
-    }
+template<typename Access>
+BasicMatrix<Access>::BasicMatrix(BasicMatrix&& other) {
+    this->n = other.n;
+    this->m = other.m;
+    this->data = other.data;
+    other.n = 0;
+    other.m = 0;
+    other.data = nullptr;
+}
+
+template<typename Access>
+BasicMatrix<Access>& BasicMatrix<Access>::operator=(BasicMatrix&& other) {
+    if (this != &other) {
+        delete[] data;
+        this->n = other.n;
+        this->m = other.m;
+        this->data = other.data;
+        other.n = 0;
+        other.m = 0;
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+template<typename Access>
+BasicMatrix<Access>::~BasicMatrix() {
+    delete[] data;
+}
+
+template<typename Access>
+double& BasicMatrix<Access>::operator()(int i) {
+    Access::check(i, 0, n, 1);
     return data[i];
 }
 
-double& Matrix::operator()(int i, int j) {
-    if (i < 0 || i >= n || j < 0 || j >= m) {
-        throw std::invalid_argument("Invalid index");
-    }
+template<typename Access>
+double& BasicMatrix<Access>::operator()(int i, int j) {
+    Access::check(i, j, n, m);
     return data[i * m + j];
 }
 
-int Matrix::size(int dim) {
+template<typename Access>
+int BasicMatrix<Access>::size(int dim) {
     if (dim == 0) {
         return n;
     } else if (dim == 1) {
@@ -53,92 +80,70 @@ int Matrix::size(int dim) {
     }
 }
 
-void Matrix::add(Matrix& m, Matrix& res, double alpha) {
-    if (n != m.size(0) || m.size(1) != res.size(1) || n != res.size(0)) {
-        throw std::invalid_argument("Invalid dimensions for matrix addition");
-    }
-    for(int i = 0; i < n; i++){
-        for(int j = 0; j < m.size(1); j++){
-            res(i, j) = (*this)(i, j) + m(i, j) * alpha;
-        }
-    }
+template<typename Access>
+void BasicMatrix<Access>::add(MatrixView m, MatrixView res, double alpha) {
+    ::add(view(), m, res, alpha);
 }
 
-void Matrix::mult(Matrix& m, Matrix& res) {
-    if (n != m.size(0) || m.size(1) != res.size(1) || n != res.size(0)) {
-        throw std::invalid_argument("Invalid dimensions for matrix multiplication");
-    }
-    for(int i = 0; i < n; i++){
-        for(int j = 0; j < m.size(1); j++){
-            res(i, j) = (*this)(i, j) * m(i, j);
-        }
-    }
+template<typename Access>
+void BasicMatrix<Access>::mult(MatrixView m, MatrixView res) {
+    ::mult(view(), m, res);
+}
+
+// transpose is a bitmask, 2 transposes this matrix and 1 the other one
+template<typename Access>
+void BasicMatrix<Access>::prod(MatrixView m, MatrixView res, int transpose) {
+    ::prod(transpose & 2 ? t() : view(), transpose & 1 ? m.t() : m, res);
 }
 
-void Matrix::prod(Matrix& m, Matrix& res, int transpose) {
-    int fT = (transpose&2)>>1;
-    int sT = transpose&1;
-    if (size(1-fT) != m.size(0+sT) || size(0+fT) != res.size(0) || m.size(1-sT) != res.size(1)) {
+template<typename Access>
+void BasicMatrix<Access>::prod_naive(MatrixView m, MatrixView res, int transpose) {
+    MatrixView a = transpose & 2 ? t() : view();
+    MatrixView b = transpose & 1 ? m.t() : m;
+    if (a.cols() != b.rows() || a.rows() != res.rows() || b.cols() != res.cols()) {
         throw std::invalid_argument("Invalid dimensions for matrix multiplication");
     }
-    for(int i = 0; i < size(0+fT); i++){
-        for(int j = 0; j < m.size(1-sT); j++){
-            res(i, j) = 0;
-            for(int k = 0; k < size(1-fT); k++){
-                
-                if(fT & sT) res(i, j) += (*this)(k, i) * m(j, k);
-                else if(fT) res(i, j) += (*this)(k, i) * m(k, j);
-                else if(sT) res(i, j) += (*this)(i, k) * m(j, k);
-                else        res(i, j) += (*this)(i, k) * m(k, j);
-
+    for(int i = 0; i < a.rows(); i++){
+        for(int j = 0; j < b.cols(); j++){
+            double sum = 0;
+            for(int k = 0; k < a.cols(); k++){
+                sum += a.at(i, k) * b.at(k, j);
             }
+            res(i, j) = sum;
         }
     }
 }
 
-double Matrix::dot(Matrix& m) {
-    if (size(1) != 1 || m.size(1) != 1 || size(0) != m.size(0)) {
+template<typename Access>
+double BasicMatrix<Access>::dot(MatrixView m) {
+    if (size(1) != 1 || m.cols() != 1) {
         throw std::invalid_argument("Invalid dimensions for dot product");
     }
-    double res = 0;
-    for(int i = 0; i < size(0); i++){
-        res += (*this)(i) * m(i);
-    }
-    return res;
+    return ::dot(view(), m);
 }
 
-double Matrix::dot(Matrix& m, int dim, int index) {
-    if (m.size(1) != 1) {
+// Column index (dim 0) or row index (dim 1) dotted with the vector m
+template<typename Access>
+double BasicMatrix<Access>::dot(MatrixView m, int dim, int index) {
+    if (m.cols() != 1) {
         throw std::invalid_argument("Invalid dimensions for matrix dot product");
     }
     if (dim < 0 || dim >= 2) {
         throw std::invalid_argument("Invalid dimension");
     }
-    if (size(dim) != m.size(0)) {
-        throw std::invalid_argument("Invalid dimensions for dot product");
-    }
     if (index < 0 || index >= size(1 - dim)) {
         throw std::invalid_argument("Invalid index");
     }
-    double res = 0;
-    if (dim == 0) {
-        for(int i = 0; i < size(0); i++){
-            res += (*this)(i, index) * m(i);
-        }
-    } else {
-        for(int i = 0; i < size(1); i++){
-            res += (*this)(index, i) * m(i);
-        }
-    }
-    return res;
+    return ::dot(dim == 0 ? col(index) : row(index).t(), m);
 }
 
-string Matrix::to_string() {
+template<typename Access>
+string BasicMatrix<Access>::to_string() {
     string res = "[";
     for(int i = 0; i < n; i++){
         res += "[";
         for(int j = 0; j < m; j++){
-            res += std::to_string((*this)(i, j));
+            res += std::to_string(at(i, j));
             if(j < m - 1) res += ", ";
         }
         res += "]";
@@ -146,4 +151,82 @@ string Matrix::to_string() {
     }
     res += "]";
     return res;
-}
\ No newline at end of file
+}
+
+template class BasicMatrix<CheckedAccess>;
+template class BasicMatrix<UncheckedAccess>;
+
+// ================== Kernels ==================
+
+// gemm reads row-major operands, a view with unit column stride is one and a view with unit row stride
+// is the transpose of one. Single rows and columns fit either way
+static bool gemm_operand(MatrixView v, bool& trans, int& ld){
+    if (v.cs == 1 || v.cols() == 1) {
+        trans = false;
+        ld = v.rows() == 1 ? v.cols() : v.rs;
+        return true;
+    }
+    if (v.rs == 1 || v.rows() == 1) {
+        trans = true;
+        ld = v.cols() == 1 ? v.rows() : v.cs;
+        return true;
+    }
+    return false;
+}
+
+void prod(MatrixView a, MatrixView b, MatrixView res, double alpha, double beta) {
+    if (a.cols() != b.rows() || a.rows() != res.rows() || b.cols() != res.cols()) {
+        throw std::invalid_argument("Invalid dimensions for matrix multiplication");
+    }
+    bool ta, tb, tc;
+    int lda, ldb, ldc;
+    if (gemm_operand(a, ta, lda) && gemm_operand(b, tb, ldb) && gemm_operand(res, tc, ldc) && !tc) {
+        gemm(ta, tb, res.rows(), res.cols(), a.cols(), alpha, a.data, lda, b.data, ldb, beta, res.data, ldc);
+        return;
+    }
+    // Any other strides, one dot product per element
+    for(int i = 0; i < res.rows(); i++){
+        for(int j = 0; j < res.cols(); j++){
+            double sum = 0;
+            for(int k = 0; k < a.cols(); k++){
+                sum += a.at(i, k) * b.at(k, j);
+            }
+            res(i, j) = alpha * sum + (beta == 0 ? 0 : beta * res(i, j));
+        }
+    }
+}
+
+void add(MatrixView a, MatrixView b, MatrixView res, double alpha) {
+    if (a.rows() != b.rows() || a.cols() != b.cols() || a.rows() != res.rows() || a.cols() != res.cols()) {
+        throw std::invalid_argument("Invalid dimensions for matrix addition");
+    }
+    for(int i = 0; i < a.rows(); i++){
+        for(int j = 0; j < a.cols(); j++){
+            res(i, j) = a.at(i, j) + b.at(i, j) * alpha;
+        }
+    }
+}
+
+void mult(MatrixView a, MatrixView b, MatrixView res) {
+    if (a.rows() != b.rows() || a.cols() != b.cols() || a.rows() != res.rows() || a.cols() != res.cols()) {
+        throw std::invalid_argument("Invalid dimensions for matrix multiplication");
+    }
+    for(int i = 0; i < a.rows(); i++){
+        for(int j = 0; j < a.cols(); j++){
+            res(i, j) = a.at(i, j) * b.at(i, j);
+        }
+    }
+}
+
+double dot(MatrixView a, MatrixView b) {
+    if (a.rows() != b.rows() || a.cols() != b.cols()) {
+        throw std::invalid_argument("Invalid dimensions for dot product");
+    }
+    double res = 0;
+    for(int i = 0; i < a.rows(); i++){
+        for(int j = 0; j < a.cols(); j++){
+            res += a.at(i, j) * b.at(i, j);
+        }
+    }
+    return res;
+}
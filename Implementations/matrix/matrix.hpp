@@ -7,29 +7,368 @@
 
 using namespace std;
 
-class Matrix{
+// ================== Global Variables ==================
+
+// Initial values of a new matrix
+#define MATRIX_RANDOM 0  // uniform in [0, 10), what the weights start from
+#define MATRIX_ZERO 1
+#define MATRIX_UNINIT 2  // left as allocated, for outputs that are always written before they are read
+
+// ================== Access Policies ==================
+
+// operator() checks its indices through the policy, the other methods check dimensions once up front
+// and index the buffer directly
+struct CheckedAccess {
+    static void check(int i, int j, int n, int m){
+        if(i < 0 || i >= n || j < 0 || j >= m){
+            throw std::invalid_argument("Invalid index");
+        }
+    }
+};
+
+struct UncheckedAccess {
+    static void check(int, int, int, int){}
+};
+
+// ================== Expressions ==================
+
+// Lazy matrix expressions, nothing is computed until one is assigned to a Matrix
+// The assignment walks the target once and evaluates every element through the whole tree,
+// so a chain like W += alpha * (d * transpose(x)) is a single loop without temporaries
+// Every node has rows(), cols() and an unchecked at(i, j), dimensions are checked once when it is built
+template<typename E>
+struct MatExpr {
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+// ================== Views ==================
+
+// A window into a matrix buffer that owns nothing, element (i, j) is data[i * rs + j * cs]
+// Transposes, rows, columns and blocks of a view are views of the same buffer, made in O(1)
+// Copying a view makes another view of the same elements, assigning to one writes the elements
+// Bounds are checked when a view is made, not on every access
+struct MatrixView : MatExpr<MatrixView> {
+double* data;
+int n;
+int m;
+int rs; // elements between rows
+int cs; // elements between columns
+
+    MatrixView(double* data, int n, int m, int rs, int cs) : data(data), n(n), m(m), rs(rs), cs(cs) {}
+    MatrixView(const MatrixView& other) = default;
+
+    int rows() const { return n; }
+    int cols() const { return m; }
+    double at(int i, int j) const { return data[(size_t)i * rs + (size_t)j * cs]; }
+    double& operator()(int i, int j) { return data[(size_t)i * rs + (size_t)j * cs]; }
+
+    MatrixView t() const { return MatrixView(data, m, n, cs, rs); }
+    MatrixView block(int i, int j, int rows, int cols) const {
+        if(i < 0 || j < 0 || rows < 0 || cols < 0 || i + rows > n || j + cols > m){
+            throw std::invalid_argument("Invalid block");
+        }
+        return MatrixView(data + (size_t)i * rs + (size_t)j * cs, rows, cols, rs, cs);
+    }
+    MatrixView row(int i) const { return block(i, 0, 1, m); }
+    MatrixView col(int j) const { return block(0, j, n, 1); }
+
+    // Same rules as for Matrix, the target may be read elementwise but not inside a product
+    MatrixView& operator=(const MatrixView& other);
+    template<typename E> MatrixView& operator=(const MatExpr<E>& expr);
+    template<typename E> MatrixView& operator+=(const MatExpr<E>& expr);
+    template<typename E> MatrixView& operator-=(const MatExpr<E>& expr);
+};
+
+// ================== Matrix ==================
+
+// Owns its buffer and can only be moved, copies go through a view (a = b.view())
+// Instantiated for both policies in matrix.cpp
+template<typename Access>
+class BasicMatrix : public MatExpr<BasicMatrix<Access>> {
 private:
     int n;
-    int m; 
+    int m;
     double* data;
-    
+
 public:
-    Matrix();
-    Matrix(int n);
-    Matrix(int n, int m);
+    BasicMatrix();
+    BasicMatrix(int n, int m = 1, int init = MATRIX_RANDOM);
+    BasicMatrix(BasicMatrix&& other);
+    BasicMatrix& operator=(BasicMatrix&& other);
+    BasicMatrix(const BasicMatrix&) = delete;
+    BasicMatrix& operator=(const BasicMatrix&) = delete;
+    ~BasicMatrix();
 
     double& operator()(int i);
     double& operator()(int i, int j);
 
+    // Views of the whole matrix or a part of it, see MatrixView
+    MatrixView view() { return MatrixView(data, n, m, m, 1); }
+    operator MatrixView() { return view(); }
+    MatrixView t() { return view().t(); }
+    MatrixView row(int i) { return view().row(i); }
+    MatrixView col(int j) { return view().col(j); }
+    MatrixView block(int i, int j, int rows, int cols) { return view().block(i, j, rows, cols); }
+
+    // The operands can be matrices or views, see the kernels below
     int size(int dim);
-    void add(Matrix& m, Matrix& res, double alpha = 1);
-    void mult(Matrix& m, Matrix& res);
-    void prod(Matrix& m, Matrix& res, int transpose = 0);
-    
-    double dot(Matrix& m);
-    double dot(Matrix& m, int dim, int index);
+    void add(MatrixView m, MatrixView res, double alpha = 1);
+    void mult(MatrixView m, MatrixView res);
+    void prod(MatrixView m, MatrixView res, int transpose = 0);
+    void prod_naive(MatrixView m, MatrixView res, int transpose = 0);
+
+    double dot(MatrixView m);
+    double dot(MatrixView m, int dim, int index);
 
     string to_string();
+
+    // Expression interface
+    int rows() const { return n; }
+    int cols() const { return m; }
+    double at(int i, int j) const { return data[i * m + j]; }
+
+    // Elementwise reads of the target are fine on the right hand side, a product that reads it is not
+    template<typename E> BasicMatrix& operator=(const MatExpr<E>& expr);
+    template<typename E> BasicMatrix& operator+=(const MatExpr<E>& expr);
+    template<typename E> BasicMatrix& operator-=(const MatExpr<E>& expr);
+};
+
+// Release builds (NDEBUG) drop the index checks
+#ifdef NDEBUG
+typedef BasicMatrix<UncheckedAccess> Matrix;
+#else
+typedef BasicMatrix<CheckedAccess> Matrix;
+#endif
+
+// ================== Kernels ==================
+
+// Every operand is a view with any strides, a matrix converts to a view of itself
+// Dimensions are checked once per call
+
+// res = alpha * a * b + beta * res, through gemm when every operand is row-major or a transpose of one
+void prod(MatrixView a, MatrixView b, MatrixView res, double alpha = 1, double beta = 0);
+// res = a + alpha * b
+void add(MatrixView a, MatrixView b, MatrixView res, double alpha = 1);
+// res = a * b elementwise
+void mult(MatrixView a, MatrixView b, MatrixView res);
+// Sum of the elementwise product of two views of the same shape
+double dot(MatrixView a, MatrixView b);
+
+// Matrices are held by reference, every other node by value, so a node never outlives a matrix it reads
+// but can be built from temporaries inside a single expression
+template<typename E> struct ExprRef { typedef const E type; };
+template<typename A> struct ExprRef<BasicMatrix<A>> { typedef const BasicMatrix<A>& type; };
+
+struct AddOp { static double apply(double a, double b){ return a + b; } };
+struct SubOp { static double apply(double a, double b){ return a - b; } };
+struct MulOp { static double apply(double a, double b){ return a * b; } };
+
+// Same shape on both sides, element by element
+template<typename L, typename R, typename Op>
+struct BinaryExpr : MatExpr<BinaryExpr<L, R, Op>> {
+typename ExprRef<L>::type l;
+typename ExprRef<R>::type r;
+
+    BinaryExpr(const L& l, const R& r) : l(l), r(r) {
+        if(l.rows() != r.rows() || l.cols() != r.cols()){
+            throw std::invalid_argument("Invalid dimensions for elementwise expression");
+        }
+    }
+    int rows() const { return l.rows(); }
+    int cols() const { return l.cols(); }
+    double at(int i, int j) const { return Op::apply(l.at(i, j), r.at(i, j)); }
+};
+
+template<typename E>
+struct ScaledExpr : MatExpr<ScaledExpr<E>> {
+double alpha;
+typename ExprRef<E>::type e;
+
+    ScaledExpr(double alpha, const E& e) : alpha(alpha), e(e) {}
+    int rows() const { return e.rows(); }
+    int cols() const { return e.cols(); }
+    double at(int i, int j) const { return alpha * e.at(i, j); }
+};
+
+// f applied to every element, f is any double(double) callable
+template<typename E, typename F>
+struct MapExpr : MatExpr<MapExpr<E, F>> {
+typename ExprRef<E>::type e;
+F f;
+
+    MapExpr(const E& e, F f) : e(e), f(f) {}
+    int rows() const { return e.rows(); }
+    int cols() const { return e.cols(); }
+    double at(int i, int j) const { return f(e.at(i, j)); }
 };
 
-#endif
\ No newline at end of file
+template<typename E>
+struct TransposeExpr : MatExpr<TransposeExpr<E>> {
+typename ExprRef<E>::type e;
+
+    TransposeExpr(const E& e) : e(e) {}
+    int rows() const { return e.cols(); }
+    int cols() const { return e.rows(); }
+    double at(int i, int j) const { return e.at(j, i); }
+};
+
+// Every element is its own dot product, meant for the matrix-vector and outer products of one sample
+// Whole matrix products should still go through Matrix::prod
+template<typename L, typename R>
+struct ProductExpr : MatExpr<ProductExpr<L, R>> {
+typename ExprRef<L>::type l;
+typename ExprRef<R>::type r;
+
+    ProductExpr(const L& l, const R& r) : l(l), r(r) {
+        if(l.cols() != r.rows()){
+            throw std::invalid_argument("Invalid dimensions for matrix multiplication");
+        }
+    }
+    int rows() const { return l.rows(); }
+    int cols() const { return r.cols(); }
+    double at(int i, int j) const {
+        if(l.cols() == 1) return l.at(i, 0) * r.at(0, j); // outer product
+        double sum = 0;
+        for(int k = 0; k < l.cols(); k++){
+            sum += l.at(i, k) * r.at(k, j);
+        }
+        return sum;
+    }
+};
+
+template<typename L, typename R>
+BinaryExpr<L, R, AddOp> operator+(const MatExpr<L>& l, const MatExpr<R>& r){
+    return BinaryExpr<L, R, AddOp>(l.self(), r.self());
+}
+
+template<typename L, typename R>
+BinaryExpr<L, R, SubOp> operator-(const MatExpr<L>& l, const MatExpr<R>& r){
+    return BinaryExpr<L, R, SubOp>(l.self(), r.self());
+}
+
+// Elementwise (Hadamard) product
+template<typename L, typename R>
+BinaryExpr<L, R, MulOp> operator%(const MatExpr<L>& l, const MatExpr<R>& r){
+    return BinaryExpr<L, R, MulOp>(l.self(), r.self());
+}
+
+// Matrix product
+template<typename L, typename R>
+ProductExpr<L, R> operator*(const MatExpr<L>& l, const MatExpr<R>& r){
+    return ProductExpr<L, R>(l.self(), r.self());
+}
+
+template<typename E>
+ScaledExpr<E> operator*(double alpha, const MatExpr<E>& e){
+    return ScaledExpr<E>(alpha, e.self());
+}
+
+template<typename E>
+ScaledExpr<E> operator*(const MatExpr<E>& e, double alpha){
+    return ScaledExpr<E>(alpha, e.self());
+}
+
+template<typename E>
+TransposeExpr<E> transpose(const MatExpr<E>& e){
+    return TransposeExpr<E>(e.self());
+}
+
+template<typename E, typename F>
+MapExpr<E, F> apply_each(const MatExpr<E>& e, F f){
+    return MapExpr<E, F>(e.self(), f);
+}
+
+// ================== Assignment ==================
+
+template<typename Access>
+template<typename E>
+BasicMatrix<Access>& BasicMatrix<Access>::operator=(const MatExpr<E>& expr){
+    const E& e = expr.self();
+    if(e.rows() != n || e.cols() != m){
+        throw std::invalid_argument("Invalid dimensions for matrix assignment");
+    }
+    for(int i = 0; i < n; i++){
+        for(int j = 0; j < m; j++){
+            data[i * m + j] = e.at(i, j);
+        }
+    }
+    return *this;
+}
+
+template<typename Access>
+template<typename E>
+BasicMatrix<Access>& BasicMatrix<Access>::operator+=(const MatExpr<E>& expr){
+    const E& e = expr.self();
+    if(e.rows() != n || e.cols() != m){
+        throw std::invalid_argument("Invalid dimensions for matrix assignment");
+    }
+    for(int i = 0; i < n; i++){
+        for(int j = 0; j < m; j++){
+            data[i * m + j] += e.at(i, j);
+        }
+    }
+    return *this;
+}
+
+template<typename Access>
+template<typename E>
+BasicMatrix<Access>& BasicMatrix<Access>::operator-=(const MatExpr<E>& expr){
+    const E& e = expr.self();
+    if(e.rows() != n || e.cols() != m){
+        throw std::invalid_argument("Invalid dimensions for matrix assignment");
+    }
+    for(int i = 0; i < n; i++){
+        for(int j = 0; j < m; j++){
+            data[i * m + j] -= e.at(i, j);
+        }
+    }
+    return *this;
+}
+
+inline MatrixView& MatrixView::operator=(const MatrixView& other){
+    return this->operator=<MatrixView>(other);
+}
+
+template<typename E>
+MatrixView& MatrixView::operator=(const MatExpr<E>& expr){
+    const E& e = expr.self();
+    if(e.rows() != n || e.cols() != m){
+        throw std::invalid_argument("Invalid dimensions for matrix assignment");
+    }
+    for(int i = 0; i < n; i++){
+        for(int j = 0; j < m; j++){
+            (*this)(i, j) = e.at(i, j);
+        }
+    }
+    return *this;
+}
+
+template<typename E>
+MatrixView& MatrixView::operator+=(const MatExpr<E>& expr){
+    const E& e = expr.self();
+    if(e.rows() != n || e.cols() != m){
+        throw std::invalid_argument("Invalid dimensions for matrix assignment");
+    }
+    for(int i = 0; i < n; i++){
+        for(int j = 0; j < m; j++){
+            (*this)(i, j) += e.at(i, j);
+        }
+    }
+    return *this;
+}
+
+template<typename E>
+MatrixView& MatrixView::operator-=(const MatExpr<E>& expr){
+    const E& e = expr.self();
+    if(e.rows() != n || e.cols() != m){
+        throw std::invalid_argument("Invalid dimensions for matrix assignment");
+    }
+    for(int i = 0; i < n; i++){
+        for(int j = 0; j < m; j++){
+            (*this)(i, j) -= e.at(i, j);
+        }
+    }
+    return *this;
+}
+
+#endif
@@ -16,23 +16,31 @@ Matrix output;
     LinearLayer(int inputSize, int outputSize){
         weights = Matrix(outputSize, inputSize);
         
-        output = Matrix(outputSize);
+        output = Matrix(outputSize, 1, MATRIX_UNINIT);
     }
 
     Matrix* forward(Matrix& input){
-        weights.prod(input, output);
+        output = weights * input;
         return &output;
     }
 };
 
+// Sigmoid and its derivative written with the output, for apply_each
+struct Sigmoid {
+    double operator()(double x) const { return 1 / (1 + exp(-x)); }
+};
+struct SigmoidD {
+    double operator()(double y) const { return y * (1 - y); }
+};
+
 class ActivationLayer{
 public:    
 Matrix output;
 Matrix output_d;
 
     ActivationLayer(int size){
-        output = Matrix(size);
-        output_d = Matrix(size);
+        output = Matrix(size, 1, MATRIX_UNINIT);
+        output_d = Matrix(size, 1, MATRIX_UNINIT);
     }
 
     Matrix* forward(Matrix& input){
@@ -41,9 +49,7 @@ Matrix output_d;
         //     output(i) = input(i) > 0 ? input(i) : 0;
         // }
         // Sigmoid
-        for(int i = 0; i < input.size(0); i++){
-            output(i) = 1 / (1 + exp(-input(i)));
-        }
+        output = apply_each(input, Sigmoid());
         return &output;
     }
 
@@ -53,11 +59,14 @@ Matrix output_d;
         //     output_d(i) = input(i) > 0 ? 1 : 0;
         // }
         // Sigmoid derivative
-        for(int i = 0; i < input.size(0); i++){
-            output_d(i) = output(i) * (1 - output(i));
-        }
+        output_d = derivative();
         return &output_d;
     }
+
+    // The derivative as an expression, so backward can fold it into the delta
+    MapExpr<Matrix, SigmoidD> derivative(){
+        return apply_each(output, SigmoidD());
+    }
 };
 
 class Error{
@@ -70,7 +79,7 @@ Matrix output_d;
     }
 
     Error(int size){
-        output_d = Matrix(size);
+        output_d = Matrix(size, 1, MATRIX_UNINIT);
     }
 
     double forward(Matrix& input, Matrix& target){
@@ -90,7 +99,12 @@ class NeuralNetwork{
 private:
 Matrix inp;
 vector<Matrix> y_deltas;
-vector<Matrix> weight_updates;
+
+// Mini-batch buffers, one sample per row, sized for batch_cap samples
+int batch_cap;
+Matrix batch_inp; // bias column included
+vector<Matrix> batch_outputs;
+vector<Matrix> batch_deltas;
 
 public:
 vector<LinearLayer> linears;
@@ -103,19 +117,18 @@ Error error;
             linears.push_back(LinearLayer(sizes[i], sizes[i + 1]));
             activations.push_back(ActivationLayer(sizes[i + 1]));
             
-            y_deltas.push_back(Matrix(sizes[i + 1]));
-            weight_updates.push_back(Matrix(sizes[i + 1], sizes[i]));
+            y_deltas.push_back(Matrix(sizes[i + 1], 1, MATRIX_UNINIT));
         }
         error = Error(sizes[sizes.size() - 1]);
 
-        inp = Matrix(sizes[0]);
+        inp = Matrix(sizes[0], 1, MATRIX_ZERO);
         inp(sizes[0]-1) = 1;
+        batch_cap = 0;
     }
 
-    Matrix* forward(Matrix& input){
-        for(int i = 0; i < input.size(0); i++){
-            inp(i) = input(i);
-        }
+    // input is a column, a view of a row of a bigger matrix works as well (data.row(i).t())
+    Matrix* forward(MatrixView input){
+        inp.block(0, 0, input.rows(), 1) = input;
         Matrix* out = &inp;
         for(int i = 0; i < (int)linears.size(); i++){
             out = activations[i].forward(*linears[i].forward(*out));
@@ -123,29 +136,20 @@ Error error;
         return out;
     }
 
-    void backward(Matrix& input, Matrix& target){
+    void backward(MatrixView input, MatrixView target){
         Matrix* out = forward(input);
-        Matrix* err = error.forward_d(*out, target);
-
-        // * Y output deltas
-        for(int i = linears.size() - 1; i >= 0; i--){
-            Matrix* fd = activations[i].forward_d(linears[i].output);
-            if(i == (int)linears.size() - 1){
-                (*err).mult(*fd, y_deltas[i]);
-            } else {
-                linears[i+1].weights.prod(y_deltas[i+1], y_deltas[i], 2);
-                y_deltas[i].mult(*fd, y_deltas[i]);
-            }
+
+        // * Y output deltas, every layer is one pass with the derivative folded in
+        int last = linears.size() - 1;
+        y_deltas[last] = (target - *out) % activations[last].derivative();
+        for(int i = last - 1; i >= 0; i--){
+            y_deltas[i] = (transpose(linears[i+1].weights) * y_deltas[i+1]) % activations[i].derivative();
         }
 
-        // * Weight Update
+        // * Weight Update, the outer product is added straight into the weights
         for(int i = 0; i < (int)linears.size(); i++){
-            if(i == 0){
-                y_deltas[i].prod(inp, weight_updates[i], 1);
-            }else{
-                y_deltas[i].prod(activations[i-1].output, weight_updates[i], 1);
-            }
-            linears[i].weights.add(weight_updates[i], linears[i].weights, 0.1);
+            Matrix& prev = i == 0 ? inp : activations[i-1].output;
+            linears[i].weights += 0.1 * (y_deltas[i] * transpose(prev));
         }
     }
 
@@ -156,6 +160,63 @@ Error error;
             }
         }
     }
+
+    void reserve_batch(int batch_size){
+        if(batch_size <= batch_cap) return;
+        batch_cap = batch_size;
+        batch_inp = Matrix(batch_size, inp.rows(), MATRIX_UNINIT);
+        for(int i = 0; i < batch_size; i++){
+            batch_inp(i, inp.rows() - 1) = 1;
+        }
+        batch_outputs.clear();
+        batch_deltas.clear();
+        for(int i = 0; i < (int)linears.size(); i++){
+            batch_outputs.push_back(Matrix(batch_size, linears[i].weights.rows(), MATRIX_UNINIT));
+            batch_deltas.push_back(Matrix(batch_size, linears[i].weights.rows(), MATRIX_UNINIT));
+        }
+    }
+
+    // inputs and targets hold one sample per row, every batch is a block of rows of them and of the buffers
+    // Each step averages the gradient of the batch
+    void train_batch(Matrix& inputs, Matrix& targets, int batch_size, int epochs){
+        reserve_batch(batch_size);
+        int n = inputs.rows(), in = inputs.cols(), last = linears.size() - 1;
+        for(int e = 0; e < epochs; e++){
+            for(int s = 0; s < n; s += batch_size){
+                int b = min(batch_size, n - s);
+                MatrixView x = batch_inp.block(0, 0, b, in + 1);
+                x.block(0, 0, b, in) = inputs.block(s, 0, b, in);
+
+                // * Forward, Z = X * W^T
+                for(int i = 0; i <= last; i++){
+                    MatrixView out = batch_rows(batch_outputs[i], b);
+                    prod(i == 0 ? x : batch_rows(batch_outputs[i-1], b), linears[i].weights.t(), out);
+                    out = apply_each(out, Sigmoid());
+                }
+
+                // * Y output deltas, D_i = (D_i+1 * W_i+1) % f'
+                MatrixView d = batch_rows(batch_deltas[last], b);
+                MatrixView out = batch_rows(batch_outputs[last], b);
+                d = (targets.block(s, 0, b, targets.cols()) - out) % apply_each(out, SigmoidD());
+                for(int i = last - 1; i >= 0; i--){
+                    MatrixView di = batch_rows(batch_deltas[i], b);
+                    prod(batch_rows(batch_deltas[i+1], b), linears[i+1].weights, di);
+                    di = di % apply_each(batch_rows(batch_outputs[i], b), SigmoidD());
+                }
+
+                // * Weight Update, W_i += lr / b * D_i^T * X_i
+                for(int i = 0; i <= last; i++){
+                    MatrixView prev = i == 0 ? x : batch_rows(batch_outputs[i-1], b);
+                    prod(batch_rows(batch_deltas[i], b).t(), prev, linears[i].weights, 0.1 / b, 1);
+                }
+            }
+        }
+    }
+
+    // First b rows of a batch buffer
+    MatrixView batch_rows(Matrix& m, int b){
+        return m.block(0, 0, b, m.cols());
+    }
 };
 
 
@@ -167,15 +228,15 @@ vector<entry> circleData(double range, double x, double y, double r, int amount)
         double cy = ((double)(rand() % 100) / 100) * range;
         double target = (cx - x) * (cx - x) + (cy - y) * (cy - y) < r * r ? 1 : 0;
 
-        Matrix dataPoint(2);
+        Matrix dataPoint(2, 1, MATRIX_UNINIT);
         dataPoint(0) = cx;
         dataPoint(1) = cy;
 
-        Matrix targetPoint(2);
+        Matrix targetPoint(2, 1, MATRIX_UNINIT);
         targetPoint(0) = target;
         targetPoint(1) = 1 - target;
 
-        data.push_back(entry(dataPoint, targetPoint));
+        data.push_back(entry(move(dataPoint), move(targetPoint)));
     }
     return data;
 }
@@ -3,73 +3,16 @@
 #include <algorithm>
 #include <string>
 #include <cmath>
-#include <thread>
 #include <chrono>
-#include <pthread.h>
-#include <mutex>
-#include <semaphore>
-#include <functional>
+#include <memory>
+
+#include "../../FastNN/cost_model.hpp"
 
 using namespace std;
 
 #define Vec vector<double>
 #define Mat vector<Vec>
 
-#define THREAD_AMOUNT 6
-
-#define PARALLEL_SMALL_BACK 0
-#define PARALLEL_BIG_BACK 0
-
-// ================== Utils ==================
-
-struct ParForData {
-    int from;
-    int to;
-    function<void(int)> f;
-};
-
-pthread_t threads[THREAD_AMOUNT];
-ParForData threadsData[THREAD_AMOUNT];
-mutex threadsRunMtx[THREAD_AMOUNT];
-mutex threadsDoneMtx[THREAD_AMOUNT];
-
-void* parallel_for_func(void* arg) {
-    intptr_t index = reinterpret_cast<intptr_t>(arg);
-    threadsDoneMtx[index].unlock();
-    ParForData* data = &threadsData[index];
-    while(1) {
-        threadsRunMtx[index].lock();
-        for (int i = data->from; i < data->to; i++) {
-            data->f(i);
-        }
-        threadsDoneMtx[index].unlock();
-    }
-}
-
-void parallel_for(int n, function<void(int)> f) {
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsData[i].from = i * n / THREAD_AMOUNT;
-        threadsData[i].to = (i + 1) * n / THREAD_AMOUNT;
-        threadsData[i].f = f;
-        threadsRunMtx[i].unlock();
-    }
-    for (int i = 0; i < THREAD_AMOUNT; i++) {
-        threadsDoneMtx[i].lock();
-    }
-}
-
-void init() {
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsRunMtx[i].lock();
-        threadsDoneMtx[i].lock();
-        threadsData[i] = {0, 0};
-        pthread_create(&threads[i], nullptr, parallel_for_func, reinterpret_cast<void*>(i));
-    }
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsDoneMtx[i].lock();
-    }
-}
-
 // ================== Data Structure ==================
 
 double operator*(const Vec& a, const Vec& b) {
@@ -190,36 +133,20 @@ public:
     }
     Vec backward(Vec& actual, Vec& target) {
         Vec delta(actual.size());
-        if(PARALLEL_SMALL_BACK){
-            parallel_for(actual.size(), [&](int i){
-                delta[i] = activation->derivative(before[i], actual[i]) * (target[i] - actual[i]);
-            });
-        }else{
-            for(int i = 0; i < actual.size(); i++){
-                delta[i] = activation->derivative(before[i], actual[i]) * (target[i] - actual[i]);
-            }
-        }
+        auto_for(actual.size(), 4.0, [&](int i){
+            delta[i] = activation->derivative(before[i], actual[i]) * (target[i] - actual[i]);
+        });
         return delta;
     }
     Vec backward(Vec& nextDelta, Layer& weights) {
         Vec delta(before.size());
-        if(PARALLEL_SMALL_BACK){
-            parallel_for(before.size(), [&](int i){
-                delta[i] = 0;
-                for(int j = 0; j < nextDelta.size(); j++){
-                    delta[i] += nextDelta[j] * weights.weights[j][i];
-                }
-                delta[i] *= activation->derivative(before[i], after[i]);
-            });
-        }else{
-            for(int i = 0; i < before.size(); i++){
-                delta[i] = 0;
-                for(int j = 0; j < nextDelta.size(); j++){
-                    delta[i] += nextDelta[j] * weights.weights[j][i];
-                }
-                delta[i] *= activation->derivative(before[i], after[i]);
+        auto_for(before.size(), 2.0 * nextDelta.size(), [&](int i){
+            delta[i] = 0;
+            for(int j = 0; j < nextDelta.size(); j++){
+                delta[i] += nextDelta[j] * weights.weights[j][i];
             }
-        }
+            delta[i] *= activation->derivative(before[i], after[i]);
+        });
         return delta;
     }
 };
@@ -267,30 +194,14 @@ struct NeuralNetwork {
             deltas[i] = activations[i].backward(deltas[i+1], layers[i + 1]);
         }
 
-        if(PARALLEL_BIG_BACK){
-            parallel_for(layers.size(), [&](int i){
-                for(int j = 0; j < layers[i].weights.size(); j++){
-                    for(int k = 0; k < layers[i].weights[j].size(); k++){
-                        if(i == 0){
-                            layers[i].weights[j][k] += lr * deltas[i][j] * input[k];
-                        }else{
-                            layers[i].weights[j][k] += lr * deltas[i][j] * activations[i-1].after[k];
-                        }
-                    }
+        // Per layer, the cost model decides whether its rows are worth splitting
+        for(int i = 0; i < layers.size(); i++){
+            Vec& prev = i == 0 ? input : activations[i-1].after;
+            auto_for(layers[i].weights.size(), 2.0 * prev.size(), [&](int j){
+                for(int k = 0; k < layers[i].weights[j].size(); k++){
+                    layers[i].weights[j][k] += lr * deltas[i][j] * prev[k];
                 }
             });
-        }else{
-            for(int i = 0; i < layers.size(); i++){
-                for(int j = 0; j < layers[i].weights.size(); j++){
-                    for(int k = 0; k < layers[i].weights[j].size(); k++){
-                        if(i == 0){
-                            layers[i].weights[j][k] += lr * deltas[i][j] * input[k];
-                        }else{
-                            layers[i].weights[j][k] += lr * deltas[i][j] * activations[i-1].after[k];
-                        }
-                    }
-                }
-            }
         }
     }
 
@@ -346,8 +257,6 @@ pair<vector<Vec>,vector<Vec>> generateCircleDataset() {
 }
 
 int main(){
-    init();
-
     srand(time(0));
     auto [dataset, resultset] = generateCircleDataset();
 
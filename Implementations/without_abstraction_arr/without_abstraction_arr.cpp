@@ -2,13 +2,11 @@
 #include <algorithm>
 #include <string>
 #include <cmath>
-#include <thread>
 #include <chrono>
-#include <thread>
-#include <mutex>
-#include <functional>
 #include <iomanip>
 
+#include "../../FastNN/cost_model.hpp"
+
 using namespace std;
 
 // ================== Global Variables ==================
@@ -18,23 +16,6 @@ using namespace std;
 #define Mat Vec*
 #define Net Mat*
 
-// Threading
-#define THREAD_AMOUNT 2
-
-#define PARALLEL_DELTA_UPDATE 0
-#define PARALLEL_WEIGHT_UPDATE 0
-
-struct ParForData {
-    int from;
-    int to;
-    function<void(int)> f;
-};
-
-thread threads[THREAD_AMOUNT];
-ParForData threadsData[THREAD_AMOUNT];
-mutex threadsRunMtx[THREAD_AMOUNT];
-mutex threadsDoneMtx[THREAD_AMOUNT];
-
 // Data
 #define Data_Entry pair<Vec, Vec>
 
@@ -61,11 +42,6 @@ string to_string(Vec& v);
 string to_string(Mat& m);
 string to_string(Net& n);
 
-// Parallel For Loop
-void* parallel_for_func(void* arg);
-void parallel_for(int n, function<void(int)> f);
-void init_parallel_for();
-
 // Activation Functions
 double relu(double x);
 double relu_d(double x, double y);
@@ -126,45 +102,6 @@ string to_string(Net n, int* sizes, int am){
     return res;
 }
 
-// ================== Parallel For Loop ==================
-
-void* parallel_for_func(void* arg) {
-    intptr_t index = reinterpret_cast<intptr_t>(arg);
-    threadsDoneMtx[index].unlock();
-    ParForData* data = &threadsData[index];
-    while(1) {
-        threadsRunMtx[index].lock();
-        for (int i = data->from; i < data->to; i++) {
-            data->f(i);
-        }
-        threadsDoneMtx[index].unlock();
-    }
-}
-
-void parallel_for(int n, function<void(int)> f) {
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsData[i].from = i * n / THREAD_AMOUNT;
-        threadsData[i].to = (i + 1) * n / THREAD_AMOUNT;
-        threadsData[i].f = f;
-        threadsRunMtx[i].unlock();
-    }
-    for (int i = 0; i < THREAD_AMOUNT; i++) {
-        threadsDoneMtx[i].lock();
-    }
-}
-
-void init_parallel_for() {
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsRunMtx[i].lock();
-        threadsDoneMtx[i].lock();
-        threadsData[i] = {0, 0};
-        threads[i] = thread(parallel_for_func, reinterpret_cast<void*>(i));
-    }
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsDoneMtx[i].lock();
-    }
-}
-
 // ================== Activation Functions ==================
 
 double relu(double x){
@@ -232,27 +169,25 @@ void backward(Vec input, Vec result, double lr = 1) {
     for(int i = 0; i < layer_sz[layer_n]; i++){
         delta[layer_n-1][i] = activation_d(beforeActivation[layer_n-1][i], afterActivation[layer_n-1][i]) * (result[i] - output[i]);
     }
+    // Only the neurons of a layer can run in parallel, the cost model keeps small layers serial
     for(int i = layer_n-2; i >= 0; i--){
-        for(int j = 0; j < layer_sz[i+1]; j++){
+        auto_for(layer_sz[i+1], 2.0 * layer_sz[i+2], [&](int j){
             double sum = 0;
             for(int k = 0; k < layer_sz[i+2]; k++){
                 sum += delta[i+1][k] * weights[i+1][k][j];
             }
             delta[i][j] = activation_d(beforeActivation[i][j], afterActivation[i][j]) * sum;
-        }
+        });
     }
 
     // Update weights
     for(int i = 0; i < layer_n; i++){
-        for(int j = 0; j < layer_sz[i+1]; j++){
+        Vec prev = i == 0 ? input : afterActivation[i-1];
+        auto_for(layer_sz[i+1], 2.0 * layer_sz[i], [&](int j){
             for(int k = 0; k < layer_sz[i]; k++){
-                if(i == 0){
-                    weights[i][j][k] += lr * delta[i][j] * input[k];
-                }else{
-                    weights[i][j][k] += lr * delta[i][j] * afterActivation[i-1][k];
-                }
+                weights[i][j][k] += lr * delta[i][j] * prev[k];
             }
-        }
+        });
     }
 }
 
@@ -298,24 +233,26 @@ void init_network() {
 
 void init(){
     srand(time(0));
-    init_parallel_for();
     init_network();
 }
 
 // ================== Data ==================
 
+// Every sample points into two shared blocks, three allocations instead of 2n + 1
 Data_Entry* getCircleData(int n, int w, int h, double x, double y, double r){
     Data_Entry* res = new Data_Entry[n];
+    double* inputs = new double[n * 2];
+    double* outputs = new double[n * 2];
     for(int i = 0; i < n; i++){
         double cx = (rand() % 1000) * (double)w / 1000;
         double cy = (rand() % 1000) * (double)h / 1000;
 
         double dist = sqrt((cx-x)*(cx-x) + (cy-y)*(cy-y));
 
-        Vec input = new double[2];
+        Vec input = inputs + i * 2;
         input[0] = cx;
         input[1] = cy;
-        Vec output = new double[2];
+        Vec output = outputs + i * 2;
         output[0] = dist <= r ? 1.0 : 0.0;
         output[1] = dist > r ? 1.0 : 0.0;
 
@@ -3,11 +3,9 @@
 #include <algorithm>
 #include <string>
 #include <cmath>
-#include <thread>
 #include <chrono>
-#include <thread>
-#include <mutex>
-#include <functional>
+
+#include "../../FastNN/cost_model.hpp"
 
 using namespace std;
 
@@ -18,23 +16,6 @@ using namespace std;
 #define Mat vector<Vec>
 #define Net vector<Mat>
 
-// Threading
-#define THREAD_AMOUNT 2
-
-#define PARALLEL_DELTA_UPDATE 0
-#define PARALLEL_WEIGHT_UPDATE 0
-
-struct ParForData {
-    int from;
-    int to;
-    function<void(int)> f;
-};
-
-thread threads[THREAD_AMOUNT];
-ParForData threadsData[THREAD_AMOUNT];
-mutex threadsRunMtx[THREAD_AMOUNT];
-mutex threadsDoneMtx[THREAD_AMOUNT];
-
 // Data
 #define Data_Entry pair<Vec, Vec>
 
@@ -62,11 +43,6 @@ string to_string(Vec& v);
 string to_string(Mat& m);
 string to_string(Net& n);
 
-// Parallel For Loop
-void* parallel_for_func(void* arg);
-void parallel_for(int n, function<void(int)> f);
-void init_parallel_for();
-
 // Activation Functions
 double relu(double x);
 double relu_d(double x, double y);
@@ -125,45 +101,6 @@ string to_string(Net& n){
     return res;
 }
 
-// ================== Parallel For Loop ==================
-
-void* parallel_for_func(void* arg) {
-    intptr_t index = reinterpret_cast<intptr_t>(arg);
-    threadsDoneMtx[index].unlock();
-    ParForData* data = &threadsData[index];
-    while(1) {
-        threadsRunMtx[index].lock();
-        for (int i = data->from; i < data->to; i++) {
-            data->f(i);
-        }
-        threadsDoneMtx[index].unlock();
-    }
-}
-
-void parallel_for(int n, function<void(int)> f) {
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsData[i].from = i * n / THREAD_AMOUNT;
-        threadsData[i].to = (i + 1) * n / THREAD_AMOUNT;
-        threadsData[i].f = f;
-        threadsRunMtx[i].unlock();
-    }
-    for (int i = 0; i < THREAD_AMOUNT; i++) {
-        threadsDoneMtx[i].lock();
-    }
-}
-
-void init_parallel_for() {
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsRunMtx[i].lock();
-        threadsDoneMtx[i].lock();
-        threadsData[i] = {0, 0};
-        threads[i] = thread(parallel_for_func, reinterpret_cast<void*>(i));
-    }
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsDoneMtx[i].lock();
-    }
-}
-
 // ================== Activation Functions ==================
 
 double relu(double x){
@@ -223,53 +160,26 @@ void backward(Vec input, Vec result, double lr = 1) {
     for(int i = 0; i < delta[layer_n-1].size(); i++){
         delta[layer_n-1][i] = activation_d(beforeActivation[layer_n-1][i], afterActivation[layer_n-1][i]) * (result[i] - output[i]);
     }
-    if(PARALLEL_DELTA_UPDATE){
-        parallel_for(layer_n-1, [&](int i){
-            for(int j = 0; j < delta[i].size(); j++){
-                double sum = 0;
-                for(int k = 0; k < delta[i+1].size(); k++){
-                    sum += delta[i+1][k] * weights[i+1][k][j];
-                }
-                delta[i][j] = activation_d(beforeActivation[i][j], afterActivation[i][j]) * sum;
+    // Each layer needs the one after it, so only the neurons of a layer can run in parallel
+    // The cost model keeps small layers serial
+    for(int i = layer_n-2; i >= 0; i--){
+        auto_for(delta[i].size(), 2.0 * delta[i+1].size(), [&](int j){
+            double sum = 0;
+            for(int k = 0; k < delta[i+1].size(); k++){
+                sum += delta[i+1][k] * weights[i+1][k][j];
             }
+            delta[i][j] = activation_d(beforeActivation[i][j], afterActivation[i][j]) * sum;
         });
-    }else{
-        for(int i = layer_n-2; i >= 0; i--){
-            for(int j = 0; j < delta[i].size(); j++){
-                double sum = 0;
-                for(int k = 0; k < delta[i+1].size(); k++){
-                    sum += delta[i+1][k] * weights[i+1][k][j];
-                }
-                delta[i][j] = activation_d(beforeActivation[i][j], afterActivation[i][j]) * sum;
-            }
-        }
     }
 
     // Update weights
-    if(PARALLEL_WEIGHT_UPDATE){
-        parallel_for(layer_n, [&](int i){
-            for(int j = 0; j < weights[i].size(); j++){
-                for(int k = 0; k < weights[i][j].size(); k++){
-                    if(i == 0){
-                        weights[i][j][k] += lr * delta[i][j] * input[k];
-                    }else{
-                        weights[i][j][k] += lr * delta[i][j] * afterActivation[i-1][k];
-                    }
-                }
+    for(int i = 0; i < layer_n; i++){
+        Vec& prev = i == 0 ? input : afterActivation[i-1];
+        auto_for(weights[i].size(), 2.0 * prev.size(), [&](int j){
+            for(int k = 0; k < weights[i][j].size(); k++){
+                weights[i][j][k] += lr * delta[i][j] * prev[k];
             }
         });
-    }else{
-        for(int i = 0; i < layer_n; i++){
-            for(int j = 0; j < weights[i].size(); j++){
-                for(int k = 0; k < weights[i][j].size(); k++){
-                    if(i == 0){
-                        weights[i][j][k] += lr * delta[i][j] * input[k];
-                    }else{
-                        weights[i][j][k] += lr * delta[i][j] * afterActivation[i-1][k];
-                    }
-                }
-            }
-        }
     }
 }
 
@@ -311,7 +221,6 @@ void init_network() {
 
 void init(){
     srand(time(0));
-    init_parallel_for();
     init_network();
 }
 
@@ -3,68 +3,30 @@
 #include <algorithm>
 #include <string>
 #include <cmath>
-#include <thread>
 #include <chrono>
-#include <pthread.h>
-#include <mutex>
-#include <semaphore>
-#include <functional>
+#include <atomic>
 
-using namespace std;
-
-struct ParForData {
-    int from;
-    int to;
-    function<void(int)> f;
-};
-
-#define THREAD_AMOUNT 4
-
-pthread_t threads[THREAD_AMOUNT];
-ParForData threadsData[THREAD_AMOUNT];
-mutex threadsRunMtx[THREAD_AMOUNT];
-mutex threadsDoneMtx[THREAD_AMOUNT];
-
-void* parallel_for_func(void* arg) {
-    intptr_t index = reinterpret_cast<intptr_t>(arg);
-    threadsDoneMtx[index].unlock();
-    ParForData* data = &threadsData[index];
-    while(1) {
-        threadsRunMtx[index].lock();
-        for (int i = data->from; i < data->to; i++) {
-            data->f(i);
-        }
-        threadsDoneMtx[index].unlock();
-    }
-}
+#include "../FastNN/cost_model.hpp"
 
-void parallel_for(int n, function<void(int)> f) {
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsData[i].from = i * n / THREAD_AMOUNT;
-        threadsData[i].to = (i + 1) * n / THREAD_AMOUNT;
-        threadsData[i].f = f;
-        threadsRunMtx[i].unlock();
-    }
-    for (int i = 0; i < THREAD_AMOUNT; i++) {
-        threadsDoneMtx[i].lock();
-    }
-}
+using namespace std;
 
-void init() {
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsRunMtx[i].lock();
-        threadsDoneMtx[i].lock();
-        threadsData[i] = {0, 0};
-        pthread_create(&threads[i], nullptr, parallel_for_func, reinterpret_cast<void*>(i));
-    }
-    for(int i = 0; i < THREAD_AMOUNT; i++){
-        threadsDoneMtx[i].lock();
+// Recursive fork-join on the pool, every level waits on its children by running queued tasks
+long long fib(ThreadPool& pool, int n){
+    if(n < 20){
+        return n < 2 ? n : fib(pool, n-1) + fib(pool, n-2);
     }
+    long long a = 0, b = 0;
+    auto left = [&]{ a = fib(pool, n-1); };
+    auto right = [&]{ b = fib(pool, n-2); };
+    TaskGroup group(pool);
+    group.run(left);
+    group.run(right);
+    group.wait();
+    return a + b;
 }
 
 int main(){
-
-    init();
+    int failed = 0;
 
     vector<int> nums(100, 0);
 
@@ -78,6 +40,7 @@ int main(){
 
     for(int i = 0; i < 100; i++){
         cout << nums[i] << " ";
+        if(nums[i] != i) failed = 1;
     }
 
     auto g = [&] (int i) {
@@ -90,7 +53,64 @@ int main(){
 
     for(int i = 0; i < 100; i++){
         cout << nums[i] << " ";
+        if(nums[i] != 2 * i) failed = 1;
+    }
+    cout << endl;
+
+    // Nested loops, the inner calls run on whichever thread picked up the outer iteration
+    atomic<int> sum(0);
+    parallel_for(16, [&](int i){
+        parallel_for(1000, [&](int j){
+            sum += 1;
+        }, 64);
+    });
+    cout << "nested " << sum << endl;
+    if(sum != 16 * 1000) failed = 1;
+
+    // Recursive tasks
+    ThreadPool& pool = thread_pool();
+    long long f30 = fib(pool, 30);
+    cout << "fib(30) " << f30 << endl;
+    if(f30 != 832040) failed = 1;
+
+    // Deque indices across the 2^32 wrap, a long run gets there one parallel_for at a time
+    TaskDeque deque;
+    deque.head = deque.tail = 0xffffffffu - 2;
+    Task task = {};
+    for(int i = 0; i < 6; i++){
+        task.from = i;
+        deque.push(task);
+    }
+    Task got;
+    bool wrap_ok = deque.steal(got) && got.from == 0 && deque.pop(got) && got.from == 5;
+    for(int i = 1; i < 5; i++) wrap_ok = wrap_ok && deque.steal(got) && got.from == i;
+    wrap_ok = wrap_ok && !deque.pop(got) && !deque.steal(got);
+    cout << "deque wrap " << (wrap_ok ? "ok" : "BROKEN") << endl;
+    if(!wrap_ok) failed = 1;
+
+    // Round trip of an empty call, what a per-layer loop would pay on top of its work
+    int calls = 100000;
+    auto startTime = chrono::high_resolution_clock::now();
+    for(int i = 0; i < calls; i++){
+        parallel_for(pool.size(), [&](int j){});
+    }
+    auto endTime = chrono::high_resolution_clock::now();
+    cout << "threads " << pool.size() << ", dispatch " << chrono::duration<double, micro>(endTime - startTime).count() / calls << " us" << endl;
+
+    // What the cost model picks for the per-layer loops of a small and a big net
+    CostModel& model = cost_model();
+    cout << "flop " << model.ns_per_flop << " ns, dispatch " << model.dispatch_ns << " ns" << endl;
+    int small[] = {3, 20, 20, 2};
+    int big[] = {3, 300, 300, 300, 2};
+    int* nets[] = {small, big};
+    int sizes[] = {4, 5};
+    for(int net = 0; net < 2; net++){
+        for(int i = 0; i + 1 < sizes[net]; i++){
+            int in = nets[net][i], out = nets[net][i+1];
+            cout << in << "x" << out << ": delta " << model.describe(in, 2.0 * out) << ", weights " << model.describe(out, 2.0 * in) << endl;
+        }
     }
 
-    return 0;
-}
\ No newline at end of file
+    if(failed) cout << "FAILED" << endl;
+    return failed;
+}
@@ -6,6 +6,7 @@
 #include <SFML/Graphics/Font.hpp>
 
 #include "../FastNN/FNN.hpp"
+#include "../FastNN/dataset.hpp"
 
 using namespace std;
 using namespace sf;
@@ -25,10 +26,13 @@ using namespace sf;
 
 #define SHOW_DATA 0
 
+// Network precision, float or double
+#define Scalar double
+
 point data_to_left(point data, double w, double h){
     return {(data.first / w) * GRAPH_WIDTH, (data.second / h) * GRAPH_HEIGHT};
 }
-point data_to_left(Vec data, double w, double h){
+point data_to_left(Vec<Scalar> data, double w, double h){
     return {(data[0] / w) * GRAPH_WIDTH, (data[1] / h) * GRAPH_HEIGHT};
 }
 
@@ -42,22 +46,20 @@ Color get_weight_color(double weight){
 
 // ================== Data ==================
 
-Data_Entry* getCircleData(int n, double w, double h, double x, double y, double r){
-    Data_Entry* res = new Data_Entry[n];
+Dataset<Scalar> getCircleData(int n, double w, double h, double x, double y, double r){
+    Dataset<Scalar> res(n, 2, 2, rand());
     for(int i = 0; i < n; i++){
         double cx = (rand() % 1000) * (double)w / 1000;
         double cy = (rand() % 1000) * (double)h / 1000;
 
         double dist = sqrt((cx-x)*(cx-x) + (cy-y)*(cy-y));
 
-        Vec input = new double[2];
+        Vec<Scalar> input = res.input(i);
         input[0] = cx;
         input[1] = cy;
-        Vec output = new double[2];
+        Vec<Scalar> output = res.target(i);
         output[0] = dist <= r ? 1.0 : 0.0;
         output[1] = dist > r ? 1.0 : 0.0;
-
-        res[i] = {input, output};
     }
     return res;
 }
@@ -70,7 +72,7 @@ int main(){
     int layer_sz[] = {2, 20, 20, 2};
     int activation = _sigmoid;
     double lr = 1;
-    FNN nn = FNN(layer_n, layer_sz, activation, lr);
+    FNN<Scalar> nn = FNN<Scalar>(layer_n, layer_sz, activation, lr);
 
     // Data Information
     int w = 10;
@@ -80,9 +82,13 @@ int main(){
     double r = 2;
 
     int training_n = 1000;
-    Data_Entry* training_data = getCircleData(training_n, w, h, x, y, r);
+    Dataset<Scalar> training_data = getCircleData(training_n, w, h, x, y, r);
     int testing_n = 1000;
-    Data_Entry* testing_data = getCircleData(testing_n, w, h, x, y, r);
+    Dataset<Scalar> testing_data = getCircleData(testing_n, w, h, x, y, r);
+
+    // The test inputs are already one block, so a frame is a single forward_batch
+    int out_sz = layer_sz[layer_n];
+    Scalar* testing_outputs = new Scalar[testing_n * out_sz];
 
 
 
@@ -100,7 +106,7 @@ int main(){
     
     vector<CircleShape> data_circles;
     for(int i = 0; i < testing_n; i++){
-        point p = data_to_left(testing_data[i].first, w, h);
+        point p = data_to_left(testing_data.input(i), w, h);
         CircleShape pt(2);
         pt.setPosition(p.first-2, p.second-2);
         data_circles.push_back(pt);
@@ -180,17 +186,18 @@ int main(){
         window.draw(circle);
 
         double cur_loss = 0;
+        nn.forward_batch(testing_data.inputs, testing_n, testing_outputs);
         for(int i = 0; i < testing_n; i++){
-            Vec input = testing_data[i].first;
-            Vec output = nn.forward(input);
+            Vec<Scalar> input = testing_data.input(i);
+            Vec<Scalar> output = testing_outputs + i * out_sz;
 
             if(i < 10 && SHOW_DATA){
                 cout << "Input: " << to_string(input, 2);
-                cout << " | Expected: " << to_string(testing_data[i].second, 2);
+                cout << " | Expected: " << to_string(testing_data.target(i), 2);
                 cout << " | Got: " << to_string(output, 2) << endl;
             }
 
-            cur_loss += nn.loss(output, testing_data[i].second);
+            cur_loss += nn.loss(output, testing_data.target(i));
             
             if(output[0] > output[1])   data_circles[i].setFillColor(Color::Green); // In
             else                        data_circles[i].setFillColor(Color::Red);   // Out
@@ -229,7 +236,7 @@ int main(){
         window.display();
 
         // train nn
-        nn.train(training_data, training_n, 100, lr);
+        nn.train(training_data, 100, lr);
     }
 
     return 0;